@@ -19,7 +19,15 @@
 
 #include "maudiofile.h"
 
+#include <maudioscheduler_p.h>
+#include <maudiostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <al.h>
 
 namespace al {
@@ -32,44 +40,174 @@ namespace al {
 }
 
 using namespace std;
+using namespace chrono;
 using namespace this_thread;
 using namespace al;
 
-void MAudioFile::m_playSync (bool stereo, int freq, Buffer buffer)
-{
-    al::format format = stereo ? STEREO16 : MONO16;
-    unsigned int source;
-    ALuint buf;
-    int state;
+/*
+ *  Sources are created once and reused, a voice is free when its source stopped.
+ *  A voice that streams a compressed clip plays it on the source of its player instead.
+ */
+static struct Voices {
+    struct Voice {
+        ALuint source;
+        ALuint buffer = 0;
+        shared_ptr<MAudioStreamPlayer> player{};
+        int priority = 0;
+        uint64_t id = 0;
+    };
+
+    static constexpr size_t size = 32;
 
-    alGenSources(1, &source);
-    alGenBuffers(1, &buf);
+    bool playing ( const Voice& voice ) {
+        if ( voice.player )
+            return !voice.player->done();
+        int state;
+        alGetSourcei(voice.source, AL_SOURCE_STATE, &state);
+        return state == AL_PLAYING || state == AL_PAUSED;
+    }
 
-    alSourcei(source, AL_SOURCE_RELATIVE, AL_TRUE);
-    alSourcef(source, AL_ROLLOFF_FACTOR, 0 );
+    Voice* find ( uint64_t id ) {
+        for ( auto& voice: voices )
+            if ( voice.id == id )
+                return &voice;
+        return nullptr;
+    }
+
+    vector<Voice> voices;
+    uint64_t counter = 0;
+} voices;
+static mutex voiceMutex;
+static atomic<double> limit{30};
+
+void MAudioFile::setDecodeLimit ( duration<double> limit )
+{
+    ::limit = limit.count();
+}
+
+duration<double> MAudioFile::decodeLimit ()
+{
+    return duration<double> { limit };
+}
 
-    alSourcei(source, AL_BUFFER, 0);
+MAudioFile::~MAudioFile()
+{
+    if ( !m_alBuffer )
+        return;
+    lock_guard<mutex> lock{voiceMutex};
+    for ( auto& voice: voices.voices )
+        if ( voice.buffer == m_alBuffer ) {
+            alSourceStop(voice.source);
+            alSourcei(voice.source, AL_BUFFER, 0);
+            voice.buffer = 0;
+        }
+    alDeleteBuffers(1, &m_alBuffer);
+}
 
-    alBufferData(buf, format, buffer->data(), buffer->size(), freq);
-    alSourceQueueBuffers(source, 1, &buf);
+/*
+ *  Picks a free voice or steals one, voiceMutex has to be locked.
+ *  @return  The voice or nullptr if all voices have a higher priority than @a priority.
+ */
+static Voices::Voice* takeVoice ( int priority )
+{
+    if ( voices.voices.empty() ) {
+        ALuint sources[Voices::size];
+        alGenSources(Voices::size, sources);
+        for ( auto source: sources ) {
+            alSourcei(source, AL_SOURCE_RELATIVE, AL_TRUE);
+            alSourcef(source, AL_ROLLOFF_FACTOR, 0 );
+            voices.voices.push_back ( {source} );
+        }
+    }
 
-    alSourcePlay(source);
+    Voices::Voice* voice = nullptr;
+    for ( auto& v: voices.voices )
+        if ( !voices.playing ( v ) ) {
+            voice = &v;
+            break;
+        }
+    if ( !voice ) {
+        for ( auto& v: voices.voices )
+            if ( !voice || v.priority < voice->priority || ( v.priority == voice->priority && v.id < voice->id ) )
+                voice = &v;
+        if ( voice->priority > priority )
+            return nullptr;
+        if ( voice->player )
+            voice->player->stop();
+        else
+            alSourceStop(voice->source);
+    }
+    voice->player = nullptr;
+    voice->priority = priority;
+    voice->id = ++voices.counter;
+    return voice;
+}
 
-    do {
-        alGetSourcei(source, AL_SOURCE_STATE, &state);
-        sleep_for(0.2s);
-    } while (state != AL_STOPPED);
+static uint64_t playVoice ( MAudioFile* file, unsigned int& alBuffer, int priority )
+{
+    lock_guard<mutex> lock{voiceMutex};
+    if ( !alBuffer ) {
+        alGenBuffers(1, &alBuffer);
+        alBufferData(alBuffer, file->stereo ? STEREO16 : MONO16, file->samples(), file->samplesSize(), file->freq);
+    }
+    auto voice = takeVoice ( priority );
+    if ( !voice )
+        return 0;
+    alSourcei(voice->source, AL_BUFFER, alBuffer);
+    alSourcePlay(voice->source);
+    voice->buffer = alBuffer;
+    return voice->id;
+}
 
-    alDeleteBuffers(1, &buf);
-    alDeleteSources(1, &source);
+/*
+ *  Streams a compressed clip on a voice, the stream is deleted when it ends.
+ */
+static shared_ptr<MAudioStreamPlayer> playCompressed ( const MByteSource& compressed, int priority )
+{
+    auto stream = new MAudioStream{compressed};
+    if ( !stream->valid() ) {
+        delete stream;
+        return nullptr;
+    }
+    lock_guard<mutex> lock{voiceMutex};
+    auto voice = takeVoice ( priority );
+    if ( !voice ) {
+        delete stream;
+        return nullptr;
+    }
+    alSourcei(voice->source, AL_BUFFER, 0);
+    voice->buffer = 0;
+    voice->player = make_shared<MAudioStreamPlayer> ( stream, nullptr, [stream] ( bool ) { delete stream; } );
+    MAudioScheduler::add ( voice->player );
+    return voice->player;
 }
 
-void MAudioFile::playSync ()
+void MAudioFile::playSync ( int priority )
 {
-    m_playSync(stereo, freq, buffer);
+    if ( compressed.size() ) {
+        if ( auto player = playCompressed ( compressed, priority ) )
+            player->wait();
+        return;
+    }
+    auto id = playVoice ( this, m_alBuffer, priority );
+    ALint samples = samplesSize() / ( stereo ? 4 : 2 );
+    // sleep for exactly as long as the rest of the clip takes to play
+    while ( id ) {
+        ALint offset;
+        {
+            lock_guard<mutex> lock{voiceMutex};
+            auto voice = voices.find ( id );
+            if ( !voice || !voices.playing ( *voice ) )
+                break;
+            alGetSourcei(voice->source, AL_SAMPLE_OFFSET, &offset);
+        }
+        sleep_for(duration<double>(max(samples - offset, 1) / double(freq)));
+    }
 }
 
-void MAudioFile::play ()
+bool MAudioFile::play ( int priority )
 {
-    thread{m_playSync, stereo, freq, buffer}.detach();
+    if ( compressed.size() )
+        return playCompressed ( compressed, priority ) != nullptr;
+    return playVoice ( this, m_alBuffer, priority );
 }
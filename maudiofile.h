@@ -21,33 +21,100 @@
 #define MAUDIOFILE_H
 
 #include <mresource.h>
+#include <mbytesource.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 class M_EXPORT MAudioFile : public MResource
 {
     class Buffer {
     public:
-        Buffer () : m_buffer{new std::vector<std::uint8_t>}, m_refcount{new int} {}
-        Buffer ( const Buffer& other ) : m_buffer{other.m_buffer}, m_refcount{other.m_refcount} { ++*m_refcount; }
-        ~Buffer () { if ( !--*m_refcount ) { delete m_buffer; delete m_refcount; } }
-        Buffer& operator= ( const Buffer& ) = default;
-        std::vector<std::uint8_t>* operator->() { return m_buffer; }
+        Buffer () : m_buffer{new std::vector<std::uint8_t>}, m_refcount{new std::atomic<int>{1}} {}
+        Buffer ( const Buffer& other ) : m_buffer{other.m_buffer}, m_refcount{other.m_refcount} {
+            m_refcount->fetch_add ( 1, std::memory_order_relaxed );
+        }
+        ~Buffer () {
+            if ( m_refcount->fetch_sub ( 1, std::memory_order_acq_rel ) == 1 ) {
+                delete m_buffer;
+                delete m_refcount;
+            }
+        }
+        Buffer& operator= ( Buffer other ) {
+            std::swap ( m_buffer, other.m_buffer );
+            std::swap ( m_refcount, other.m_refcount );
+            return *this;
+        }
+        std::vector<std::uint8_t>* operator->() const { return m_buffer; }
 
     private:
         std::vector<std::uint8_t>* m_buffer;
-        volatile int* m_refcount{};
+        // voices hold copies and are released on the mixer and scheduler threads
+        std::atomic<int>* m_refcount{};
     };
 
 public:
+    /**
+     *  Loaders of this type return instances of MAudioFile or its subclasses.
+     */
+    static constexpr Type resourceType = Audio;
+
     bool stereo = false;
     int freq = 0;
     Buffer buffer{};
-    void playSync ();
-    void play ();
+
+    /**
+     *  The encoded clip if it's longer than decodeLimit(), @c buffer is empty then.
+     *  Such clips are decoded while they play.
+     */
+    MByteSource compressed{};
+
+    /**
+     *  16-bit samples used where they are stored in an uncompressed file, @c buffer is empty then.
+     */
+    MByteSource pcm{};
+
+    virtual ~MAudioFile ();
+    virtual std::size_t memoryUsage () const override { return buffer->size() + compressed.size() + pcm.size(); }
+
+    /**
+     *  @return  The 16-bit samples, from @c pcm or @c buffer.
+     */
+    const std::uint8_t* samples () const { return pcm ? pcm.data() : buffer->data(); }
+    std::size_t samplesSize () const { return pcm ? pcm.size() : buffer->size(); }
+
+    /**
+     *  Clips longer than @a limit are loaded compressed, 30 seconds by default.
+     */
+    static void setDecodeLimit ( std::chrono::duration<double> limit );
+
+    /**
+     *  @return  Length up to which clips are decoded when they are loaded.
+     */
+    static std::chrono::duration<double> decodeLimit ();
+
+    /**
+     *  Plays the clip on a voice like play() and waits until it finishes.
+     */
+    void playSync ( int priority = 0 );
+
+    /**
+     *  Plays the clip on one of a fixed pool of voices and returns immediately.
+     *  The samples are uploaded to OpenAL once, on the first call.
+     *  If all voices are busy the lowest priority voice that started first is stolen,
+     *  voices with a higher priority than @a priority are never stolen.
+     *  Compressed clips are streamed on a source of their own but take a voice too,
+     *  so they count against the pool and are stolen by the same rules, which stops their stream.
+     *  @return  False if no voice was available.
+     */
+    bool play ( int priority = 0 );
 
 private:
-    static void m_playSync ( bool stereo, int freq, Buffer buffer );
+    unsigned int m_alBuffer = 0;
 };
 
+template<> struct MResourceTyped<MAudioFile> : std::true_type {};
+
 #endif // MAUDIOFILE_H
@@ -0,0 +1,400 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "maudiolibrary.h"
+
+#include <maudiostream.h>
+#include <mbytesource.h>
+#include <mdebug.h>
+#include <mtaskbatch_p.h>
+#include <mthreadpool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+constexpr char magic[8] = { 'M', 'L', 'I', 'B', 'A', 'L', 'I', 'B' };
+constexpr std::uint32_t version = 1;
+
+/*
+ *  The index is a header, an array of records and a block of null-terminated strings
+ *  the records point into. Equal strings are only stored once.
+ */
+struct IndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t count;
+    std::uint64_t strings;
+};
+
+struct IndexRecord {
+    std::int64_t mtime;
+    std::uint64_t size;
+    double length;
+    std::uint32_t file;
+    std::uint32_t title;
+    std::uint32_t artist;
+    std::uint32_t album;
+    std::uint32_t genre;
+    std::int32_t trackNumber;
+    std::int32_t discNumber;
+    std::uint32_t valid;
+};
+
+struct Stamp {
+    std::int64_t mtime;
+    std::uint64_t size;
+};
+
+static bool stamp ( const std::string& file, Stamp& stamp )
+{
+    std::error_code error;
+    stamp.size = std::filesystem::file_size ( file, error );
+    if ( error )
+        return false;
+    stamp.mtime = std::filesystem::last_write_time ( file, error ).time_since_epoch().count();
+    return !error;
+}
+
+static std::string tag ( MAudioStream& stream, MAudioTag tag )
+{
+    auto values = stream.getTag ( tag );
+    return values.empty() ? std::string{} : values.front();
+}
+
+struct MAudioLibraryPrivate {
+    struct Entry {
+        Stamp stamp;
+        // files that aren't audio are remembered too so they aren't opened again
+        bool valid;
+        MAudioLibrary::Track track;
+    };
+
+    void load ();
+    void scan ( const std::string& file, Stamp stamp );
+    std::vector<MAudioLibrary::Track> select ( std::string MAudioLibrary::Track::* tag, const std::string& value );
+    std::vector<std::string> values ( std::string MAudioLibrary::Track::* tag );
+
+    MAudioLibrary* q;
+    std::string index;
+    std::map<std::string, Entry> entries;
+    std::mutex mutex;
+    std::size_t total = 0;
+    std::size_t scanned = 0;
+    std::atomic<bool> cancelled{false};
+    MTaskBatch batch{true};
+};
+
+void MAudioLibraryPrivate::load ()
+{
+    std::error_code error;
+    if ( index.empty() || !std::filesystem::exists ( index, error ) )
+        return;
+    auto source = MByteSource::map ( index );
+    auto header = reinterpret_cast<const IndexHeader*> ( source.data() );
+    if ( source.size() < sizeof ( IndexHeader ) || std::memcmp ( header->magic, magic, sizeof magic ) || header->version != version ||
+         ( source.size() - sizeof ( IndexHeader ) ) / sizeof ( IndexRecord ) < header->count ||
+         header->strings != source.size() - sizeof ( IndexHeader ) - header->count * sizeof ( IndexRecord ) ) {
+        mDebug(ERROR) << index << ": Invalid index";
+        return;
+    }
+    auto records = reinterpret_cast<const IndexRecord*> ( header + 1 );
+    auto strings = reinterpret_cast<const char*> ( records + header->count );
+    if ( header->count && ( !header->strings || strings[header->strings - 1] ) ) {
+        mDebug(ERROR) << index << ": Invalid index";
+        return;
+    }
+    auto string = [header, strings] ( std::uint32_t offset ) {
+        return offset < header->strings ? std::string{strings + offset} : std::string{};
+    };
+    for ( std::uint32_t i = 0; i < header->count; i++ ) {
+        auto& record = records[i];
+        Entry entry{{record.mtime, record.size}, record.valid != 0, {}};
+        entry.track.file = string ( record.file );
+        entry.track.title = string ( record.title );
+        entry.track.artist = string ( record.artist );
+        entry.track.album = string ( record.album );
+        entry.track.genre = string ( record.genre );
+        entry.track.trackNumber = record.trackNumber;
+        entry.track.discNumber = record.discNumber;
+        entry.track.length = std::chrono::duration<double> { record.length };
+        entries.emplace ( entry.track.file, std::move ( entry ) );
+    }
+}
+
+void MAudioLibraryPrivate::scan ( const std::string& file, Stamp stamp )
+{
+    if ( !cancelled ) {
+        Entry entry{stamp, false, {}};
+        entry.track.file = file;
+        MAudioStream stream{file};
+        if ( stream.valid() ) {
+            entry.valid = true;
+            entry.track.title = tag ( stream, M_AUDIO_TAG_TITLE );
+            entry.track.artist = tag ( stream, M_AUDIO_TAG_ARTIST );
+            entry.track.album = tag ( stream, M_AUDIO_TAG_ALBUM );
+            entry.track.genre = tag ( stream, M_AUDIO_TAG_GENRE );
+            entry.track.trackNumber = std::atoi ( tag ( stream, M_AUDIO_TAG_TRACK_NUMBER ).c_str() );
+            entry.track.discNumber = std::atoi ( tag ( stream, M_AUDIO_TAG_DISC_NUMBER ).c_str() );
+            entry.track.length = stream.length();
+        }
+        std::lock_guard<std::mutex> lock{mutex};
+        entries[file] = std::move ( entry );
+    }
+    std::size_t processed;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        processed = ++scanned;
+    }
+    if ( !cancelled )
+        q->progress ( processed, total );
+    if ( !batch.finish() )
+        return;
+    q->finished ( cancelled );
+    batch.complete();
+}
+
+std::vector<MAudioLibrary::Track> MAudioLibraryPrivate::select ( std::string MAudioLibrary::Track::* tag, const std::string& value )
+{
+    std::vector<MAudioLibrary::Track> tracks;
+    std::lock_guard<std::mutex> lock{mutex};
+    for ( auto&& entry: entries )
+        if ( entry.second.valid && ( !tag || entry.second.track.*tag == value ) )
+            tracks.push_back ( entry.second.track );
+    return tracks;
+}
+
+std::vector<std::string> MAudioLibraryPrivate::values ( std::string MAudioLibrary::Track::* tag )
+{
+    std::vector<std::string> values;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        for ( auto&& entry: entries )
+            if ( entry.second.valid && !( entry.second.track.*tag ).empty() )
+                values.push_back ( entry.second.track.*tag );
+    }
+    std::sort ( values.begin(), values.end() );
+    values.erase ( std::unique ( values.begin(), values.end() ), values.end() );
+    return values;
+}
+
+MAudioLibrary::MAudioLibrary ( const std::string& index )
+    : d{new MAudioLibraryPrivate}
+{
+    d->q = this;
+    d->index = index;
+    d->load();
+}
+
+MAudioLibrary::~MAudioLibrary ()
+{
+    cancel();
+    wait();
+    delete d;
+}
+
+void MAudioLibrary::scan ( const std::list<std::string>& files )
+{
+    wait();
+    std::vector<std::pair<std::string,Stamp>> changed;
+    auto check = [this, &changed] ( const std::string& file ) {
+        Stamp current;
+        if ( !stamp ( file, current ) )
+            return;
+        std::lock_guard<std::mutex> lock{d->mutex};
+        auto entry = d->entries.find ( file );
+        if ( entry == d->entries.end() || entry->second.stamp.mtime != current.mtime || entry->second.stamp.size != current.size )
+            changed.emplace_back ( file, current );
+    };
+    // drops the entries under @a dir that weren't found there
+    auto prune = [this] ( std::string dir, const std::unordered_set<std::string>& found ) {
+        if ( dir.back() != '/' )
+            dir += '/';
+        std::lock_guard<std::mutex> lock{d->mutex};
+        for ( auto i = d->entries.lower_bound ( dir ); i != d->entries.end() && !i->first.compare ( 0, dir.size(), dir ); ) {
+            if ( found.count ( i->first ) )
+                ++i;
+            else
+                i = d->entries.erase ( i );
+        }
+    };
+    for ( auto&& file: files ) {
+        std::error_code error;
+        if ( !std::filesystem::is_directory ( file, error ) ) {
+            if ( !std::filesystem::exists ( file, error ) && !error ) {
+                remove ( file );
+                prune ( file, {} );
+            }
+            else
+                check ( file );
+            continue;
+        }
+        std::unordered_set<std::string> found;
+        std::filesystem::recursive_directory_iterator i{file, error}, end;
+        for ( ; !error && i != end; i.increment ( error ) )
+            if ( i->is_regular_file ( error ) ) {
+                found.insert ( i->path().string() );
+                check ( i->path().string() );
+            }
+        // a walk that failed half way didn't see everything
+        if ( !error )
+            prune ( file, found );
+    }
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+        d->cancelled = false;
+        d->total = changed.size();
+        d->scanned = 0;
+    }
+    if ( changed.empty() ) {
+        finished ( false );
+        return;
+    }
+    d->batch.add ( changed.size() );
+    for ( auto&& file: changed )
+        MThreadPool::global().push ( std::bind ( &MAudioLibraryPrivate::scan, d, file.first, file.second ) );
+}
+
+void MAudioLibrary::cancel ()
+{
+    d->cancelled = true;
+}
+
+void MAudioLibrary::wait ()
+{
+    d->batch.wait();
+}
+
+bool MAudioLibrary::done ()
+{
+    return d->batch.done();
+}
+
+void MAudioLibrary::remove ( const std::string& file )
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    d->entries.erase ( file );
+}
+
+bool MAudioLibrary::save ()
+{
+    if ( d->index.empty() )
+        return false;
+    std::vector<IndexRecord> records;
+    std::string strings;
+    std::unordered_map<std::string, std::uint32_t> offsets;
+    auto intern = [&strings, &offsets] ( const std::string& string ) {
+        auto offset = offsets.emplace ( string, strings.size() );
+        if ( offset.second )
+            strings.append ( string.c_str(), string.size() + 1 );
+        return offset.first->second;
+    };
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+        records.reserve ( d->entries.size() );
+        for ( auto&& entry: d->entries ) {
+            auto& track = entry.second.track;
+            IndexRecord record{};
+            record.mtime = entry.second.stamp.mtime;
+            record.size = entry.second.stamp.size;
+            record.length = track.length.count();
+            record.file = intern ( entry.first );
+            record.title = intern ( track.title );
+            record.artist = intern ( track.artist );
+            record.album = intern ( track.album );
+            record.genre = intern ( track.genre );
+            record.trackNumber = track.trackNumber;
+            record.discNumber = track.discNumber;
+            record.valid = entry.second.valid;
+            records.push_back ( record );
+        }
+    }
+    IndexHeader header{};
+    std::memcpy ( header.magic, magic, sizeof magic );
+    header.version = version;
+    header.count = records.size();
+    header.strings = strings.size();
+    std::ostringstream tmp;
+    tmp << d->index << '.' << std::this_thread::get_id();
+    {
+        std::ofstream out{tmp.str(), std::ios::binary | std::ios::trunc};
+        out.write ( reinterpret_cast<const char*> ( &header ), sizeof header );
+        out.write ( reinterpret_cast<const char*> ( records.data() ), records.size() * sizeof ( IndexRecord ) );
+        out.write ( strings.data(), strings.size() );
+        if ( !out ) {
+            mDebug(ERROR) << d->index << ": Write error";
+            out.close();
+            std::remove ( tmp.str().c_str() );
+            return false;
+        }
+    }
+    return std::rename ( tmp.str().c_str(), d->index.c_str() ) == 0;
+}
+
+std::size_t MAudioLibrary::size ()
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return std::count_if ( d->entries.begin(), d->entries.end(), [] ( const std::pair<const std::string, MAudioLibraryPrivate::Entry>& entry ) { return entry.second.valid; } );
+}
+
+std::vector<MAudioLibrary::Track> MAudioLibrary::tracks ()
+{
+    return d->select ( nullptr, {} );
+}
+
+std::vector<MAudioLibrary::Track> MAudioLibrary::byArtist ( const std::string& artist )
+{
+    return d->select ( &Track::artist, artist );
+}
+
+std::vector<MAudioLibrary::Track> MAudioLibrary::byAlbum ( const std::string& album )
+{
+    return d->select ( &Track::album, album );
+}
+
+std::vector<MAudioLibrary::Track> MAudioLibrary::byGenre ( const std::string& genre )
+{
+    return d->select ( &Track::genre, genre );
+}
+
+std::vector<std::string> MAudioLibrary::artists ()
+{
+    return d->values ( &Track::artist );
+}
+
+std::vector<std::string> MAudioLibrary::albums ()
+{
+    return d->values ( &Track::album );
+}
+
+std::vector<std::string> MAudioLibrary::genres ()
+{
+    return d->values ( &Track::genre );
+}
@@ -0,0 +1,137 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MAUDIOLIBRARY_H
+#define MAUDIOLIBRARY_H
+
+#include <mglobal.h>
+#include <chrono>
+#include <list>
+#include <sigxx.hh>
+#include <string>
+#include <vector>
+
+/**
+ *  Tags and lengths of a collection of songs.
+ *  Files are scanned on the global thread pool and remembered in an index file,
+ *  files that didn't change since they were scanned are not opened again.
+ */
+class M_EXPORT MAudioLibrary
+{
+public:
+    struct Track {
+        std::string file;
+        std::string title;
+        std::string artist;
+        std::string album;
+        std::string genre;
+        int trackNumber = 0;
+        int discNumber = 0;
+        std::chrono::duration<double> length{};
+    };
+
+    /**
+     *  Reads the index @a index if it exists.
+     *  An empty path keeps the library in memory only.
+     */
+    explicit MAudioLibrary ( const std::string& index = {} );
+    MAudioLibrary ( const MAudioLibrary& ) = delete;
+
+    /**
+     *  Cancels scanning and waits for the files being scanned.
+     */
+    ~MAudioLibrary ();
+    MAudioLibrary& operator= ( const MAudioLibrary& ) = delete;
+
+    /**
+     *  Starts scanning @a files, directories are scanned recursively.
+     *  Files whose size and modification time match the index are skipped.
+     *  Files that were in the index but are no longer found in a scanned directory are removed from it,
+     *  as are files passed here that no longer exist.
+     *  Waits for the previous scan to finish first.
+     */
+    void scan ( const std::list<std::string>& files );
+
+    /**
+     *  Stops scanning, files that are already being scanned are finished.
+     */
+    void cancel ();
+
+    /**
+     *  Blocks until scanning is finished or cancelled.
+     */
+    void wait ();
+
+    /**
+     *  @return  True if no scan is running.
+     */
+    bool done ();
+
+    /**
+     *  Forgets @a file.
+     */
+    void remove ( const std::string& file );
+
+    /**
+     *  Writes the index.
+     *  @return  False if there is no index file or it couldn't be written.
+     */
+    bool save ();
+
+    /**
+     *  @return  Number of songs in the library.
+     */
+    std::size_t size ();
+
+    /**
+     *  @return  All the songs, sorted by path.
+     */
+    std::vector<Track> tracks ();
+
+    std::vector<Track> byArtist ( const std::string& artist );
+    std::vector<Track> byAlbum ( const std::string& album );
+    std::vector<Track> byGenre ( const std::string& genre );
+
+    /**
+     *  @return  Distinct values of the tag, sorted.
+     */
+    std::vector<std::string> artists ();
+    std::vector<std::string> albums ();
+    std::vector<std::string> genres ();
+
+    /**
+     *  A file was scanned.
+     *  Emitted from a worker thread.
+     *  @param  1 Number of files scanned so far.
+     *  @param  2 Number of files that needed scanning.
+     */
+    sigxx::signal<std::size_t,std::size_t> progress{this};
+
+    /**
+     *  All files were scanned.
+     *  Emitted from a worker thread, or from scan() if nothing needed scanning.
+     *  @param  1 True if scanning was cancelled.
+     */
+    sigxx::signal<bool> finished{this};
+
+private:
+    struct MAudioLibraryPrivate* const d;
+};
+
+#endif // MAUDIOLIBRARY_H
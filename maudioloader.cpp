@@ -22,46 +22,46 @@
 #include <maudiofile.h>
 #include <mdebug.h>
 
-#include <fstream>
-
 static class MAudioLoader : public MResourceLoader
 {
-    virtual bool valid ( std::string file ) override;
-    virtual MResource* load ( std::string file ) override;
+    virtual std::list<std::string> magic() override;
+    virtual MResource* load ( const MByteSource& source ) override;
     virtual MResource::Type type() override;
     virtual std::string name() override;
 } audioLoader;
 
-bool MAudioLoader::valid ( std::string file )
+std::list<std::string> MAudioLoader::magic()
 {
-    std::ifstream stream{file};
-    if ( !stream.is_open() )
-        mDebug() << file << ": No such file or directory.";
-    if ( !stream.good() )
-        return false;
-    for ( auto iface: MAudioStreamInterface::interfaces() )
-        if ( iface->valid ( &stream ) )
-            return true;
-    return false;
+    return { "OggS", "RIFF" };
 }
 
-MResource* MAudioLoader::load ( std::string file )
+MResource* MAudioLoader::load ( const MByteSource& source )
 {
-    auto fileStream = new std::ifstream{file, std::ios_base::binary};
-    if ( !fileStream->is_open() ) {
-        delete fileStream;
-        return nullptr;
-    }
-    MAudioStream audioStream{fileStream};
+    MAudioStream audioStream{source};
     if ( !audioStream.valid() )
         return nullptr;
     auto audioFile = new MAudioFile;
     audioFile->stereo = audioStream.stereo();
     audioFile->freq = audioStream.freq();
+    // uncompressed files are played from where they are mapped
+    if ( ( audioFile->pcm = audioStream.pcm() ) )
+        return audioFile;
+    auto frames = audioStream.frames();
+    if ( frames > MAudioFile::decodeLimit().count() * audioFile->freq ) {
+        audioFile->compressed = source;
+        return audioFile;
+    }
+    // the exact size is known up front, so decode straight into the buffer on this thread
+    auto& buffer = audioFile->buffer;
+    buffer->resize ( frames * ( audioFile->stereo ? 4 : 2 ) );
+    buffer->resize ( audioStream.decode ( reinterpret_cast<char*> ( buffer->data() ), buffer->size() ) );
+    // streams that don't know their length, or have more than they said
+    char tail[0x4000];
     while ( !audioStream.eof() ) {
-        audioStream.initRead();
-        audioStream.waitRead();
-        audioFile->buffer->insert ( audioFile->buffer->end(), audioStream.buffer, audioStream.buffer + audioStream.buffer_size );
+        auto size = audioStream.decode ( tail, sizeof tail );
+        if ( !size )
+            break;
+        buffer->insert ( buffer->end(), tail, tail + size );
     }
     return audioFile;
 }
@@ -0,0 +1,453 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "maudiomixer.h"
+
+#include <maudiofile.h>
+#include <maudioscheduler_p.h>
+#include <maudiostream.h>
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <al.h>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define M_MIXER_X86
+#include <immintrin.h>
+#endif
+
+/*
+ *  Kernels work on interleaved stereo.
+ *  mix adds src scaled by the gain of each channel to bus,
+ *  clip converts bus to 16 bit, saturating at full scale.
+ */
+struct MixerKernels {
+    void (*mix) ( float* bus, const float* src, std::size_t frames, float left, float right );
+    void (*clip) ( const float* bus, std::int16_t* out, std::size_t frames );
+};
+
+static void mixScalar ( float* bus, const float* src, std::size_t frames, float left, float right )
+{
+    for ( std::size_t i = 0; i < frames; i++ ) {
+        bus[2 * i] += src[2 * i] * left;
+        bus[2 * i + 1] += src[2 * i + 1] * right;
+    }
+}
+
+static void clipScalar ( const float* bus, std::int16_t* out, std::size_t frames )
+{
+    for ( std::size_t i = 0; i < frames * 2; i++ )
+        out[i] = std::lrint ( std::clamp ( bus[i], -1.0f, 1.0f ) * 32767.0f );
+}
+
+#ifdef M_MIXER_X86
+__attribute__((target("sse2")))
+static void mixSSE2 ( float* bus, const float* src, std::size_t frames, float left, float right )
+{
+    auto gain = _mm_setr_ps ( left, right, left, right );
+    std::size_t i = 0;
+    for ( ; i + 2 <= frames; i += 2 ) {
+        auto sum = _mm_add_ps ( _mm_loadu_ps ( bus + 2 * i ), _mm_mul_ps ( _mm_loadu_ps ( src + 2 * i ), gain ) );
+        _mm_storeu_ps ( bus + 2 * i, sum );
+    }
+    mixScalar ( bus + 2 * i, src + 2 * i, frames - i, left, right );
+}
+
+__attribute__((target("sse2")))
+static void clipSSE2 ( const float* bus, std::int16_t* out, std::size_t frames )
+{
+    auto low = _mm_set1_ps ( -1.0f );
+    auto high = _mm_set1_ps ( 1.0f );
+    auto scale = _mm_set1_ps ( 32767.0f );
+    std::size_t i = 0;
+    for ( ; i + 4 <= frames; i += 4 ) {
+        auto a = _mm_mul_ps ( _mm_min_ps ( _mm_max_ps ( _mm_loadu_ps ( bus + 2 * i ), low ), high ), scale );
+        auto b = _mm_mul_ps ( _mm_min_ps ( _mm_max_ps ( _mm_loadu_ps ( bus + 2 * i + 4 ), low ), high ), scale );
+        auto packed = _mm_packs_epi32 ( _mm_cvtps_epi32 ( a ), _mm_cvtps_epi32 ( b ) );
+        _mm_storeu_si128 ( reinterpret_cast<__m128i*> ( out + 2 * i ), packed );
+    }
+    clipScalar ( bus + 2 * i, out + 2 * i, frames - i );
+}
+
+__attribute__((target("avx2")))
+static void mixAVX2 ( float* bus, const float* src, std::size_t frames, float left, float right )
+{
+    auto gain = _mm256_setr_ps ( left, right, left, right, left, right, left, right );
+    std::size_t i = 0;
+    for ( ; i + 4 <= frames; i += 4 ) {
+        auto sum = _mm256_add_ps ( _mm256_loadu_ps ( bus + 2 * i ), _mm256_mul_ps ( _mm256_loadu_ps ( src + 2 * i ), gain ) );
+        _mm256_storeu_ps ( bus + 2 * i, sum );
+    }
+    mixScalar ( bus + 2 * i, src + 2 * i, frames - i, left, right );
+}
+
+__attribute__((target("avx2")))
+static void clipAVX2 ( const float* bus, std::int16_t* out, std::size_t frames )
+{
+    auto low = _mm256_set1_ps ( -1.0f );
+    auto high = _mm256_set1_ps ( 1.0f );
+    auto scale = _mm256_set1_ps ( 32767.0f );
+    std::size_t i = 0;
+    for ( ; i + 8 <= frames; i += 8 ) {
+        auto a = _mm256_mul_ps ( _mm256_min_ps ( _mm256_max_ps ( _mm256_loadu_ps ( bus + 2 * i ), low ), high ), scale );
+        auto b = _mm256_mul_ps ( _mm256_min_ps ( _mm256_max_ps ( _mm256_loadu_ps ( bus + 2 * i + 8 ), low ), high ), scale );
+        // packs works within 128 bit lanes, put the quarters back in order
+        auto packed = _mm256_packs_epi32 ( _mm256_cvtps_epi32 ( a ), _mm256_cvtps_epi32 ( b ) );
+        packed = _mm256_permute4x64_epi64 ( packed, 0xd8 );
+        _mm256_storeu_si256 ( reinterpret_cast<__m256i*> ( out + 2 * i ), packed );
+    }
+    clipScalar ( bus + 2 * i, out + 2 * i, frames - i );
+}
+#endif
+
+static MixerKernels selectKernels ()
+{
+#ifdef M_MIXER_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports ( "avx2" ) )
+        return { mixAVX2, clipAVX2 };
+    if ( __builtin_cpu_supports ( "sse2" ) )
+        return { mixSSE2, clipSSE2 };
+#endif
+    return { mixScalar, clipScalar };
+}
+
+static const MixerKernels kernels = selectKernels();
+
+struct MixerVoice {
+    std::uint64_t id = 0;
+    decltype(MAudioFile::buffer) buffer{};
+    MByteSource pcm{};
+    MAudioStream* stream = nullptr;
+    // the stream decoding a compressed clip, owned by the voice
+    std::shared_ptr<MAudioStream> owned{};
+    const std::int16_t* data = nullptr;
+    // streams are decoded to floats, only clips hold 16-bit samples
+    const float* samples = nullptr;
+    std::size_t frames = 0;
+    bool stereo = false;
+    double position = 0;
+    double step = 1;
+    float gain = 1;
+    float pan = 0;
+};
+
+/*
+ *  Converts the voice to float stereo at the rate of the mixer, interpolating linearly.
+ *  Returns less than @a frames when the voice ends.
+ *  A stream is silent until its next block is decoded, the mixer doesn't wait for the decoder.
+ */
+static inline float sample ( const MixerVoice& voice, std::size_t index )
+{
+    return voice.samples ? voice.samples[index] : voice.data[index] * ( 1.0f / 32768.0f );
+}
+
+static std::size_t render ( MixerVoice& voice, float* out, std::size_t frames )
+{
+    std::size_t i = 0;
+    while ( i < frames ) {
+        if ( voice.position >= voice.frames ) {
+            if ( !voice.stream || voice.stream->eof() )
+                break;
+            if ( !voice.stream->tryRead() ) {
+                std::fill ( out + 2 * i, out + 2 * frames, 0.0f );
+                return frames;
+            }
+            voice.position -= voice.frames;
+            voice.samples = reinterpret_cast<const float*> ( voice.stream->buffer );
+            voice.frames = voice.stream->buffer_size / ( voice.stereo ? 2 : 1 ) / sizeof(float);
+            continue;
+        }
+        std::size_t index = voice.position;
+        std::size_t next = index + 1 < voice.frames ? index + 1 : index;
+        float frac = voice.position - index;
+        float left, right;
+        if ( voice.stereo ) {
+            left = sample ( voice, 2 * index ) + ( sample ( voice, 2 * next ) - sample ( voice, 2 * index ) ) * frac;
+            right = sample ( voice, 2 * index + 1 ) + ( sample ( voice, 2 * next + 1 ) - sample ( voice, 2 * index + 1 ) ) * frac;
+        }
+        else
+            left = right = sample ( voice, index ) + ( sample ( voice, next ) - sample ( voice, index ) ) * frac;
+        out[2 * i] = left;
+        out[2 * i + 1] = right;
+        voice.position += voice.step;
+        i++;
+    }
+    return i;
+}
+
+/*
+ *  Feeds the mix to an output from the audio scheduler thread.
+ */
+class MixerOutput : public MAudioPlayer
+{
+public:
+    MixerOutput ( MAudioMixer* mixer, MAudioMixer::Output output ) : m_mixer{mixer}, m_output{output} {}
+
+    void stop () {
+        m_stopped = true;
+        MAudioScheduler::wake();
+        if ( MAudioScheduler::onThread() )
+            return;
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_cond.wait ( lock, [this] { return m_done; } );
+    }
+
+    virtual bool update ( Clock::time_point& next ) override;
+
+private:
+    static constexpr std::size_t period = 1024;
+    static constexpr std::size_t n_buffers = 4;
+
+    MAudioMixer* const m_mixer;
+    const MAudioMixer::Output m_output;
+    std::atomic<bool> m_stopped{false};
+    bool m_done = false;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    ALuint m_source = 0;
+    ALuint m_buffers[n_buffers];
+    std::vector<ALuint> m_free;
+    Clock::time_point m_next;
+    std::int16_t m_pcm[period * 2];
+};
+
+bool MixerOutput::update ( Clock::time_point& next )
+{
+    if ( m_stopped ) {
+        if ( m_source ) {
+            alSourceStop(m_source);
+            alSourcei(m_source, AL_BUFFER, 0);
+            alDeleteSources(1, &m_source);
+            alDeleteBuffers(n_buffers, m_buffers);
+        }
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_done = true;
+        }
+        m_cond.notify_all();
+        return false;
+    }
+
+    auto duration = std::chrono::duration_cast<Clock::duration> ( std::chrono::duration<double> { double ( period ) / m_mixer->freq() } );
+
+    if ( m_output == MAudioMixer::Null ) {
+        // keep to the wall clock so the mix advances in real time
+        auto now = Clock::now();
+        if ( m_next == Clock::time_point{} )
+            m_next = now;
+        while ( m_next <= now ) {
+            m_mixer->mix ( m_pcm, period );
+            m_next += duration;
+        }
+        next = m_next;
+        return true;
+    }
+
+    if ( !m_source ) {
+        alGenSources(1, &m_source);
+        alGenBuffers(n_buffers, m_buffers);
+        alSourcei(m_source, AL_SOURCE_RELATIVE, AL_TRUE);
+        alSourcef(m_source, AL_ROLLOFF_FACTOR, 0 );
+        m_free.assign ( m_buffers, m_buffers + n_buffers );
+    }
+
+    ALint processed;
+    alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+    if ( processed > 0 ) {
+        std::vector<ALuint> buffers ( processed );
+        alSourceUnqueueBuffers(m_source, processed, buffers.data());
+        m_free.insert ( m_free.end(), buffers.begin(), buffers.end() );
+    }
+    while ( !m_free.empty() ) {
+        m_mixer->mix ( m_pcm, period );
+        alBufferData(m_free.back(), AL_FORMAT_STEREO16, m_pcm, sizeof(m_pcm), m_mixer->freq());
+        alSourceQueueBuffers(m_source, 1, &m_free.back());
+        m_free.pop_back();
+    }
+
+    int state;
+    alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+    if ( state != AL_PLAYING )
+        alSourcePlay(m_source);
+
+    ALint offset;
+    alGetSourcei(m_source, AL_SAMPLE_OFFSET, &offset);
+    next = Clock::now() + duration * std::max<ALint> ( period - offset, 0 ) / period;
+    return true;
+}
+
+struct MAudioMixerPrivate {
+    int freq;
+    std::mutex mutex;
+    std::list<MixerVoice> voices;
+    std::uint64_t counter = 0;
+    std::shared_ptr<MixerOutput> output;
+    float scratch[512];
+};
+
+MAudioMixer::MAudioMixer ( int freq ) : d{new MAudioMixerPrivate}
+{
+    d->freq = freq;
+}
+
+MAudioMixer::~MAudioMixer()
+{
+    stop();
+    delete d;
+}
+
+void MAudioMixer::start ( Output output )
+{
+    stop();
+    d->output = std::make_shared<MixerOutput> ( this, output );
+    MAudioScheduler::add ( d->output );
+}
+
+void MAudioMixer::stop ()
+{
+    if ( !d->output )
+        return;
+    d->output->stop();
+    d->output = nullptr;
+}
+
+std::uint64_t MAudioMixer::play ( MAudioFile* file, float gain, float pan )
+{
+    if ( file->compressed.size() ) {
+        std::shared_ptr<MAudioStream> stream{new MAudioStream{file->compressed}};
+        if ( !stream->valid() )
+            return 0;
+        stream->setSampleFormat ( M_AUDIO_SAMPLE_FLOAT32 );
+        stream->initRead();
+        MixerVoice voice;
+        voice.stream = stream.get();
+        voice.owned = stream;
+        voice.stereo = stream->stereo();
+        voice.step = double ( stream->freq() ) / d->freq;
+        voice.gain = gain;
+        voice.pan = pan;
+        std::lock_guard<std::mutex> lock{d->mutex};
+        voice.id = ++d->counter;
+        d->voices.push_back ( voice );
+        return voice.id;
+    }
+    MixerVoice voice{0, file->buffer};
+    voice.pcm = file->pcm;
+    voice.data = reinterpret_cast<const std::int16_t*> ( file->samples() );
+    voice.stereo = file->stereo;
+    voice.frames = file->samplesSize() / ( voice.stereo ? 4 : 2 );
+    voice.step = double ( file->freq ) / d->freq;
+    voice.gain = gain;
+    voice.pan = pan;
+    std::lock_guard<std::mutex> lock{d->mutex};
+    voice.id = ++d->counter;
+    d->voices.push_back ( voice );
+    return voice.id;
+}
+
+std::uint64_t MAudioMixer::play ( MAudioStream* stream, float gain, float pan )
+{
+    stream->setSampleFormat ( M_AUDIO_SAMPLE_FLOAT32 );
+    stream->initRead();
+    MixerVoice voice;
+    voice.stream = stream;
+    voice.stereo = stream->stereo();
+    voice.step = double ( stream->freq() ) / d->freq;
+    voice.gain = gain;
+    voice.pan = pan;
+    std::lock_guard<std::mutex> lock{d->mutex};
+    voice.id = ++d->counter;
+    d->voices.push_back ( voice );
+    return voice.id;
+}
+
+void MAudioMixer::setGain ( std::uint64_t voice, float gain )
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    for ( auto& v: d->voices )
+        if ( v.id == voice )
+            v.gain = gain;
+}
+
+void MAudioMixer::setPan ( std::uint64_t voice, float pan )
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    for ( auto& v: d->voices )
+        if ( v.id == voice )
+            v.pan = pan;
+}
+
+void MAudioMixer::stop ( std::uint64_t voice )
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    d->voices.remove_if ( [voice] ( const MixerVoice& v ) { return v.id == voice; } );
+}
+
+bool MAudioMixer::playing ( std::uint64_t voice )
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return std::any_of ( d->voices.begin(), d->voices.end(), [voice] ( const MixerVoice& v ) { return v.id == voice; } );
+}
+
+std::size_t MAudioMixer::voices ()
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return d->voices.size();
+}
+
+int MAudioMixer::freq () const
+{
+    return d->freq;
+}
+
+void MAudioMixer::mix ( float* bus, std::size_t frames )
+{
+    constexpr std::size_t chunk = sizeof(d->scratch) / sizeof(*d->scratch) / 2;
+    std::fill ( bus, bus + frames * 2, 0.0f );
+    std::lock_guard<std::mutex> lock{d->mutex};
+    for ( auto i = d->voices.begin(); i != d->voices.end(); ) {
+        float left = i->gain * std::min ( 1.0f, 1.0f - i->pan );
+        float right = i->gain * std::min ( 1.0f, 1.0f + i->pan );
+        bool finished = false;
+        for ( std::size_t done = 0; done < frames && !finished; ) {
+            auto wanted = std::min ( chunk, frames - done );
+            auto rendered = render ( *i, d->scratch, wanted );
+            kernels.mix ( bus + done * 2, d->scratch, rendered, left, right );
+            done += rendered;
+            finished = rendered < wanted;
+        }
+        if ( finished )
+            i = d->voices.erase ( i );
+        else
+            ++i;
+    }
+}
+
+void MAudioMixer::mix ( std::int16_t* out, std::size_t frames )
+{
+    float bus[512];
+    constexpr std::size_t chunk = sizeof(bus) / sizeof(*bus) / 2;
+    for ( std::size_t done = 0; done < frames; done += chunk ) {
+        auto n = std::min ( chunk, frames - done );
+        mix ( bus, n );
+        kernels.clip ( bus, out + done * 2, n );
+    }
+}
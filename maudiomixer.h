@@ -0,0 +1,113 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MAUDIOMIXER_H
+#define MAUDIOMIXER_H
+
+#include <mglobal.h>
+#include <cstdint>
+
+class MAudioFile;
+class MAudioStream;
+
+/**
+ *  Mixes any number of clips and streams into one stereo output stream.
+ *  Voices are identified by the number returned from play(), 0 is never a valid voice.
+ */
+class M_EXPORT MAudioMixer
+{
+public:
+    enum Output {
+        /** Streams the mix to an OpenAL source. */
+        OpenAL,
+        /** Mixes in real time and discards the result, for running without audio. */
+        Null,
+    };
+
+    /**
+     *  Constructs a mixer producing @a freq frames per second.
+     */
+    explicit MAudioMixer ( int freq = 44100 );
+    MAudioMixer ( const MAudioMixer& ) = delete;
+
+    /**
+     *  Stops the output and drops all voices.
+     */
+    ~MAudioMixer ();
+    MAudioMixer& operator= ( const MAudioMixer& ) = delete;
+
+    /**
+     *  Starts feeding the mix to @a output, replacing the current output.
+     */
+    void start ( Output output = OpenAL );
+
+    /**
+     *  Stops feeding the mix to the output.
+     */
+    void stop ();
+
+    /**
+     *  Plays @a file, which must stay loaded until the voice finishes.
+     *  A compressed file is decoded while it plays.
+     *  @param  gain Volume of the voice.
+     *  @param  pan Position from -1.0 (left) to 1.0 (right).
+     *  @return  The voice.
+     */
+    std::uint64_t play ( MAudioFile* file, float gain = 1, float pan = 0 );
+
+    /**
+     *  Plays @a stream until its end. The stream must not be read by anything else meanwhile.
+     *  It's switched to float samples so they are mixed without converting them.
+     *  @return  The voice.
+     */
+    std::uint64_t play ( MAudioStream* stream, float gain = 1, float pan = 0 );
+
+    void setGain ( std::uint64_t voice, float gain );
+    void setPan ( std::uint64_t voice, float pan );
+    void stop ( std::uint64_t voice );
+
+    /**
+     *  @return  True until @a voice finishes or is stopped.
+     */
+    bool playing ( std::uint64_t voice );
+
+    /**
+     *  @return  The number of voices playing.
+     */
+    std::size_t voices ();
+
+    int freq () const;
+
+    /**
+     *  Mixes the next @a frames frames of all voices into @a bus as interleaved stereo.
+     *  The output calls this, call it directly to mix offline.
+     *  Streams whose next block isn't decoded yet are silent until it is.
+     */
+    void mix ( float* bus, std::size_t frames );
+
+    /**
+     *  Mixes like mix(float*, std::size_t) and clips the result to 16 bits.
+     */
+    void mix ( std::int16_t* out, std::size_t frames );
+
+private:
+    struct MAudioMixerPrivate* const d;
+};
+
+#endif // MAUDIOMIXER_H
@@ -0,0 +1,460 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "maudioscheduler_p.h"
+
+#include <maudiostream.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <thread>
+#include <al.h>
+
+namespace al {
+    enum format {
+        MONO8 = AL_FORMAT_MONO8,
+        MONO16 = AL_FORMAT_MONO16,
+        STEREO8 = AL_FORMAT_STEREO8,
+        STEREO16 = AL_FORMAT_STEREO16,
+    };
+}
+
+using namespace al;
+
+/*
+ *  @return  The buffer format for the samples of @a stream or 0 if OpenAL can't take them.
+ */
+static ALenum bufferFormat ( MAudioStream* stream )
+{
+    if ( stream->sampleFormat() == M_AUDIO_SAMPLE_INT16 )
+        return stream->stereo() ? STEREO16 : MONO16;
+    if ( !alIsExtensionPresent ( "AL_EXT_FLOAT32" ) )
+        return 0;
+    return alGetEnumValue ( stream->stereo() ? "AL_FORMAT_STEREO_FLOAT32" : "AL_FORMAT_MONO_FLOAT32" );
+}
+
+static struct Scheduler {
+    ~Scheduler () {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            quit = true;
+        }
+        cond.notify_all();
+        if ( thread.joinable() )
+            thread.join();
+    }
+
+    void run ();
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::list< std::shared_ptr<MAudioPlayer> > added;
+    bool woken = false;
+    bool quit = false;
+    std::thread thread;
+} scheduler;
+
+static thread_local bool schedulerThread = false;
+
+void Scheduler::run ()
+{
+    schedulerThread = true;
+    std::list< std::pair< std::shared_ptr<MAudioPlayer>, MAudioPlayer::Clock::time_point > > players;
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;) {
+        auto next = MAudioPlayer::Clock::time_point::max();
+        for ( auto& player: players )
+            next = std::min ( next, player.second );
+        auto ready = [this] { return quit || woken || !added.empty(); };
+        if ( next == MAudioPlayer::Clock::time_point::max() )
+            cond.wait ( lock, ready );
+        else
+            cond.wait_until ( lock, next, ready );
+        if ( quit )
+            return;
+        bool all = woken;
+        woken = false;
+        for ( auto& player: added )
+            players.emplace_back ( std::move ( player ), MAudioPlayer::Clock::time_point::min() );
+        added.clear();
+        lock.unlock();
+        auto now = MAudioPlayer::Clock::now();
+        for ( auto i = players.begin(); i != players.end(); ) {
+            if ( !all && i->second > now ) {
+                ++i;
+                continue;
+            }
+            if ( i->first->update ( i->second ) )
+                ++i;
+            else
+                i = players.erase ( i );
+        }
+        lock.lock();
+    }
+}
+
+void MAudioScheduler::add ( std::shared_ptr<MAudioPlayer> player )
+{
+    std::lock_guard<std::mutex> lock{scheduler.mutex};
+    scheduler.added.push_back ( std::move ( player ) );
+    if ( !scheduler.thread.joinable() )
+        scheduler.thread = std::thread{&Scheduler::run, &scheduler};
+    scheduler.cond.notify_all();
+}
+
+void MAudioScheduler::wake ()
+{
+    std::lock_guard<std::mutex> lock{scheduler.mutex};
+    scheduler.woken = true;
+    scheduler.cond.notify_all();
+}
+
+bool MAudioScheduler::onThread ()
+{
+    return schedulerThread;
+}
+
+MAudioStreamPlayer::MAudioStreamPlayer ( MAudioStream* stream, const float* volume, std::function<void(bool)> finished )
+    : m_stream{stream}, m_playing{stream}, m_volume{volume}, m_finished{std::move ( finished )}, m_position{stream->tell().count()}
+{
+}
+
+void MAudioStreamPlayer::setNext ( std::function<MAudioStream*(MAudioStream*)> next, std::function<void(MAudioStream*)> advanced )
+{
+    m_next = std::move ( next );
+    m_advanced = std::move ( advanced );
+}
+
+void MAudioStreamPlayer::setBuffering ( const MAudioBuffering& buffering )
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_buffering = buffering;
+        m_rebuffer = true;
+    }
+    MAudioScheduler::wake();
+}
+
+MAudioStreamingStatistics MAudioStreamPlayer::statistics () const
+{
+    MAudioStreamingStatistics statistics;
+    statistics.underruns = m_underruns;
+    statistics.chunks = m_chunks;
+    statistics.decodeTime = std::chrono::nanoseconds { m_decodeTime.load() };
+    statistics.queued = m_queuedCount;
+    statistics.buffers = m_depth;
+    statistics.chunkSize = m_chunk;
+    return statistics;
+}
+
+void MAudioStreamPlayer::play ()
+{
+    m_paused = false;
+    MAudioScheduler::wake();
+}
+
+void MAudioStreamPlayer::pause ()
+{
+    m_paused = true;
+    MAudioScheduler::wake();
+}
+
+void MAudioStreamPlayer::stop ()
+{
+    m_stopped = true;
+    MAudioScheduler::wake();
+}
+
+void MAudioStreamPlayer::seek ( std::chrono::duration<double> seconds )
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_seek = true;
+        m_seekTarget = seconds.count();
+    }
+    MAudioScheduler::wake();
+}
+
+void MAudioStreamPlayer::wait ()
+{
+    if ( MAudioScheduler::onThread() )
+        return;
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_cond.wait ( lock, [this] { return m_done.load(); } );
+}
+
+bool MAudioStreamPlayer::refill ( bool once )
+{
+    bool queued = false;
+    while ( !m_free.empty() ) {
+        if ( m_stream->eof() ) {
+            if ( m_nextAsked || !m_next )
+                break;
+            m_nextAsked = true;
+            auto next = m_next ( m_stream );
+            if ( !next || next->freq() != m_stream->freq() || next->stereo() != m_stream->stereo() )
+                break;
+            next->setSampleFormat ( m_stream->sampleFormat() );
+            next->setChunkSize ( m_chunk );
+            m_stream = next;
+            m_seenChunks = m_stream->decodedChunks();
+            m_seenTime = m_stream->decodeTime().count();
+            m_spliced.push_back ( next );
+            m_stream->initRead();
+            m_nextAsked = false;
+            continue;
+        }
+        // the decoder wakes the scheduler when the next block is ready
+        if ( !m_stream->tryRead() )
+            break;
+        auto chunks = m_stream->decodedChunks();
+        auto time = m_stream->decodeTime().count();
+        m_chunks += chunks - m_seenChunks;
+        m_decodeTime += time - m_seenTime;
+        m_windowChunks += chunks - m_seenChunks;
+        m_windowTime += time - m_seenTime;
+        m_seenChunks = chunks;
+        m_seenTime = time;
+        if ( m_stream == m_playing )
+            m_position = m_stream->tell().count();
+        if ( !m_stream->buffer_size )
+            continue;
+        auto buffer = m_free.back();
+        m_free.pop_back();
+        alBufferData(buffer, m_format, m_stream->buffer, m_stream->buffer_size, m_stream->freq());
+        alSourceQueueBuffers(m_source, 1, &buffer);
+        m_queued.push_back ( { int ( m_stream->buffer_size / m_frame ), m_stream } );
+        queued = true;
+        if ( once )
+            break;
+    }
+    return queued;
+}
+
+void MAudioStreamPlayer::resize ()
+{
+    while ( m_buffers.size() < m_depth ) {
+        unsigned int buffer;
+        alGenBuffers(1, &buffer);
+        m_buffers.push_back ( buffer );
+        m_free.push_back ( buffer );
+    }
+    // buffers that are still queued are deleted once they are processed
+    while ( m_buffers.size() > m_depth && !m_free.empty() ) {
+        auto buffer = m_free.back();
+        m_free.pop_back();
+        m_buffers.erase ( std::find ( m_buffers.begin(), m_buffers.end(), buffer ) );
+        alDeleteBuffers(1, &buffer);
+    }
+}
+
+void MAudioStreamPlayer::adapt ( bool underrun )
+{
+    m_windowUnderrun |= underrun;
+    // time it takes to play a chunk and to decode one
+    double play = double ( m_chunk ) / m_frame / m_stream->freq();
+    double decode = m_windowChunks ? m_windowTime * 1e-9 / m_windowChunks : 0;
+    auto depth = m_depth.load();
+    auto chunk = m_chunk.load();
+    if ( m_windowUnderrun || ( m_windowChunks >= 16 && decode > play / 4 ) ) {
+        depth = std::min ( depth + 2, maxBuffers );
+        chunk = std::min<std::size_t> ( chunk * 2, 0x10000 );
+    }
+    else if ( m_windowChunks >= 64 && decode < play / 16 ) {
+        depth = std::max ( depth - 1, minBuffers );
+        chunk = std::max<std::size_t> ( chunk / 2, 0x1000 );
+    }
+    else {
+        // undecided, look at a fresh window when this one grows stale
+        if ( m_windowChunks >= 64 ) {
+            m_windowChunks = 0;
+            m_windowTime = 0;
+        }
+        return;
+    }
+    m_depth = depth;
+    m_stream->setChunkSize ( chunk );
+    m_chunk = m_stream->chunkSize();
+    m_windowChunks = 0;
+    m_windowTime = 0;
+    m_windowUnderrun = false;
+}
+
+void MAudioStreamPlayer::unsplice ()
+{
+    // the following streams were already started but never got to play
+    for ( auto stream: m_spliced )
+        stream->seek ( std::chrono::duration<double>::zero() );
+    m_spliced.clear();
+    m_stream = m_playing;
+}
+
+void MAudioStreamPlayer::finish ( bool stopped )
+{
+    unsplice();
+    if ( m_source ) {
+        alSourceStop(m_source);
+        alSourcei(m_source, AL_BUFFER, 0);
+        alDeleteSources(1, &m_source);
+        alDeleteBuffers(m_buffers.size(), m_buffers.data());
+        m_buffers.clear();
+        m_free.clear();
+        m_source = 0;
+    }
+    if ( m_finished )
+        m_finished ( stopped );
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_done = true;
+    }
+    m_cond.notify_all();
+}
+
+bool MAudioStreamPlayer::update ( Clock::time_point& next )
+{
+    if ( m_stopped ) {
+        finish ( true );
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if ( m_rebuffer ) {
+            m_rebuffer = false;
+            m_depth = std::clamp ( m_buffering.buffers, minBuffers, maxBuffers );
+            m_stream->setChunkSize ( m_buffering.chunkSize );
+            m_chunk = m_stream->chunkSize();
+            m_adaptive = m_buffering.adaptive;
+        }
+    }
+
+    if ( !m_source ) {
+        alGenSources(1, &m_source);
+        alSourcei(m_source, AL_SOURCE_RELATIVE, AL_TRUE);
+        alSourcef(m_source, AL_ROLLOFF_FACTOR, 0 );
+        alSourcei(m_source, AL_BUFFER, 0);
+        m_format = bufferFormat ( m_stream );
+        if ( !m_format ) {
+            // no float buffers without AL_EXT_FLOAT32
+            m_stream->setSampleFormat ( M_AUDIO_SAMPLE_INT16 );
+            m_format = bufferFormat ( m_stream );
+        }
+        m_frame = ( m_stream->stereo() ? 2 : 1 ) * ( m_stream->sampleFormat() == M_AUDIO_SAMPLE_FLOAT32 ? sizeof(float) : sizeof(std::int16_t) );
+        m_seenChunks = m_stream->decodedChunks();
+        m_seenTime = m_stream->decodeTime().count();
+        m_stream->initRead();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        if ( m_seek ) {
+            m_seek = false;
+            auto target = m_seekTarget;
+            lock.unlock();
+            // drop everything queued so the new position is heard right away
+            alSourceStop(m_source);
+            ALint queued;
+            alGetSourcei(m_source, AL_BUFFERS_QUEUED, &queued);
+            std::vector<ALuint> buffers ( queued );
+            alSourceUnqueueBuffers(m_source, queued, buffers.data());
+            m_free.insert ( m_free.end(), buffers.begin(), buffers.end() );
+            m_queued.clear();
+            m_started = false;
+            unsplice();
+            m_nextAsked = false;
+            m_stream->seek ( std::chrono::duration<double> { target } );
+            m_position = m_stream->tell().count();
+            m_priming = true;
+        }
+    }
+
+    if ( m_volume )
+        alSourcef(m_source, AL_GAIN, *m_volume);
+
+    ALint processed;
+    alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
+    if ( processed > 0 ) {
+        std::vector<ALuint> buffers ( processed );
+        alSourceUnqueueBuffers(m_source, processed, buffers.data());
+        m_free.insert ( m_free.end(), buffers.begin(), buffers.end() );
+        m_queued.erase ( m_queued.begin(), m_queued.begin() + std::min<std::size_t> ( processed, m_queued.size() ) );
+    }
+    resize();
+    refill ( m_priming );
+    m_queuedCount = m_queued.size();
+
+    while ( !m_queued.empty() && m_queued.front().stream != m_playing ) {
+        auto previous = m_playing;
+        m_playing = m_queued.front().stream;
+        m_spliced.pop_front();
+        m_position = m_playing->tell().count();
+        if ( m_advanced )
+            m_advanced ( previous );
+    }
+
+    int state;
+    alGetSourcei(m_source, AL_SOURCE_STATE, &state);
+    bool ended = m_queued.empty() && ( m_stream->eof() || !m_stream->valid() );
+    // a source that was playing only stops by itself when it runs out of buffers
+    bool underrun = m_started && state == AL_STOPPED && !ended;
+    if ( underrun ) {
+        m_underruns++;
+        m_started = false;
+    }
+    if ( m_adaptive )
+        adapt ( underrun );
+
+    if ( ended ) {
+        finish ( false );
+        return false;
+    }
+
+    if ( m_queued.empty() ) {
+        // nothing is decoded yet, the decoder wakes the scheduler
+        next = Clock::time_point::max();
+        return true;
+    }
+
+    if ( m_paused ) {
+        if ( state == AL_PLAYING )
+            alSourcePause(m_source);
+        next = Clock::time_point::max();
+        return true;
+    }
+
+    if ( state != AL_PLAYING ) {
+        alSourcePlay(m_source);
+        m_started = true;
+    }
+
+    if ( m_priming ) {
+        // the seeked position is already audible, fill the rest of the queue right away
+        m_priming = false;
+        next = Clock::now();
+        return true;
+    }
+
+    // sleep until the buffer being played runs out
+    ALint offset;
+    alGetSourcei(m_source, AL_SAMPLE_OFFSET, &offset);
+    auto remaining = std::max ( m_queued.front().frames - offset, 0 );
+    next = Clock::now() + std::chrono::duration_cast<Clock::duration> ( std::chrono::duration<double> { double ( remaining ) / m_stream->freq() } );
+    return true;
+}
@@ -0,0 +1,193 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MAUDIOSCHEDULER_P_H
+#define MAUDIOSCHEDULER_P_H
+
+#include <maudiostream.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ *  Something serviced by the audio scheduler thread.
+ */
+class MAudioPlayer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~MAudioPlayer() = default;
+
+    /**
+     *  Called on the scheduler thread when the player is added,
+     *  when its deadline passes and on every MAudioScheduler::wake().
+     *  @param  next When to call it again, Clock::time_point::max() to wait for wake().
+     *  @return  False if the player is done and should be removed.
+     */
+    virtual bool update ( Clock::time_point& next ) = 0;
+};
+
+namespace MAudioScheduler
+{
+    /**
+     *  Starts servicing @a player, the scheduler keeps a reference until it's done.
+     */
+    void add ( std::shared_ptr<MAudioPlayer> player );
+
+    /**
+     *  Services all players now instead of waiting for their deadlines.
+     */
+    void wake ();
+
+    /**
+     *  @return  True if called from the scheduler thread.
+     */
+    bool onThread ();
+}
+
+/**
+ *  Streams an MAudioStream to an OpenAL source.
+ *  Float samples are played as they are if OpenAL supports AL_EXT_FLOAT32,
+ *  otherwise the stream is switched to 16-bit samples.
+ *  Controls only record the request and wake the scheduler,
+ *  the source is owned by the scheduler thread.
+ *  The player sets the chunk size of the streams it plays from its buffering.
+ *  Only blocks the decoder thread already decoded are queued, the scheduler thread never waits for them.
+ */
+class MAudioStreamPlayer : public MAudioPlayer
+{
+public:
+    /**
+     *  @param  stream Stream to play, not owned.
+     *  @param  volume Read on every update if not null.
+     *  @param  finished Called on the scheduler thread when playback ends, with true if it was stopped.
+     */
+    MAudioStreamPlayer ( MAudioStream* stream, const float* volume = nullptr, std::function<void(bool)> finished = {} );
+
+    void play ();
+    void pause ();
+    void stop ();
+    /**
+     *  Drops the queued buffers and seeks the stream.
+     *  Only the short first block after the seek is queued before playback resumes,
+     *  the rest of the queue is filled on the next update while it plays.
+     */
+    void seek ( std::chrono::duration<double> seconds );
+
+    /**
+     *  @return  Position of the stream after the last decoded block.
+     */
+    std::chrono::duration<double> tell () const { return std::chrono::duration<double> { m_position }; }
+
+    bool playing () const { return !m_done && !m_paused; }
+    bool done () const { return m_done; }
+
+    /**
+     *  Waits until playback ends. Returns immediately on the scheduler thread.
+     */
+    void wait ();
+
+    /**
+     *  Sets the function asked for the stream to play after the current one.
+     *  It's called on the scheduler thread once the current stream is decoded to the end,
+     *  while the queued buffers still play. A stream with the same rate and channels
+     *  is decoded into the same source queue so there is no gap between them.
+     *  @param  next Returns the stream after the one passed to it or nullptr to end playback.
+     *  @param  advanced Called with the previous stream when the next one starts playing.
+     */
+    void setNext ( std::function<MAudioStream*(MAudioStream*)> next, std::function<void(MAudioStream*)> advanced );
+
+    /**
+     *  Changes the queue depth and chunk size, takes effect on the next update.
+     *  The queue depth is clamped to 2 - 64 buffers.
+     */
+    void setBuffering ( const MAudioBuffering& buffering );
+
+    /**
+     *  @return  The counters, safe to call from any thread.
+     */
+    MAudioStreamingStatistics statistics () const;
+
+    virtual bool update ( Clock::time_point& next ) override;
+
+private:
+    bool refill ( bool once = false );
+    void resize ();
+    void adapt ( bool underrun );
+    void unsplice ();
+    void finish ( bool stopped );
+
+    static constexpr std::size_t minBuffers = 2;
+    static constexpr std::size_t maxBuffers = 64;
+
+    struct Queued {
+        int frames;
+        MAudioStream* stream;
+    };
+
+    MAudioStream* m_stream;
+    MAudioStream* m_playing;
+    std::deque<MAudioStream*> m_spliced;
+    const float* const m_volume;
+    std::function<void(bool)> m_finished;
+    std::function<MAudioStream*(MAudioStream*)> m_next;
+    std::function<void(MAudioStream*)> m_advanced;
+    bool m_nextAsked = false;
+    std::atomic<bool> m_paused{false};
+    std::atomic<bool> m_stopped{false};
+    std::atomic<bool> m_done{false};
+    std::atomic<double> m_position{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_seek = false;
+    bool m_priming = false;
+    double m_seekTarget = 0;
+    MAudioBuffering m_buffering;
+    bool m_rebuffer = true;
+    bool m_adaptive = false;
+    bool m_started = false;
+    unsigned int m_source = 0;
+    int m_format = 0;
+    std::size_t m_frame = 0;
+    std::vector<unsigned int> m_buffers;
+    std::vector<unsigned int> m_free;
+    std::deque<Queued> m_queued;
+    std::atomic<std::size_t> m_depth{0};
+    std::atomic<std::size_t> m_chunk{0};
+    std::atomic<std::size_t> m_queuedCount{0};
+    std::atomic<std::uint64_t> m_underruns{0};
+    std::atomic<std::uint64_t> m_chunks{0};
+    std::atomic<std::int64_t> m_decodeTime{0};
+    // decoder counters of m_stream that were already added
+    std::uint64_t m_seenChunks = 0;
+    std::int64_t m_seenTime = 0;
+    // what happened since adapt() last changed anything
+    std::uint64_t m_windowChunks = 0;
+    std::int64_t m_windowTime = 0;
+    bool m_windowUnderrun = false;
+};
+
+#endif // MAUDIOSCHEDULER_P_H
@@ -19,7 +19,18 @@
 
 #include "maudiostream.h"
 
+#include <maudioscheduler_p.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <vector>
 
 class MIStream : public std::istream {
 public:
@@ -29,17 +40,87 @@ public:
         else
             clear();
     }
-    explicit MIStream ( const char* file ) : MIStream{new std::filebuf} {
-        if ( !static_cast<std::filebuf*> (rdbuf())->open ( file, in | binary ) )
-            setstate ( failbit );
-        else
-            clear();
-    }
     explicit MIStream ( std::streambuf* streambuf ) : std::istream{streambuf} {}
     virtual ~MIStream() { delete rdbuf(); }
 };
 
-MAudioStream::MAudioStream ( std::istream* stream ) : m_interface{nullptr}, m_stream{stream}
+/*
+ *  Lets interfaces that only know stream() read a byte source.
+ */
+class MByteStreambuf : public std::streambuf
+{
+public:
+    explicit MByteStreambuf ( const MByteSource& source ) {
+        auto begin = reinterpret_cast<char*> ( const_cast<std::uint8_t*> ( source.data() ) );
+        setg ( begin, begin, begin + source.size() );
+    }
+
+protected:
+    virtual pos_type seekoff ( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode ) override {
+        char* pos;
+        switch ( dir ) {
+            case std::ios_base::beg:
+                pos = eback() + off;
+                break;
+            case std::ios_base::cur:
+                pos = gptr() + off;
+                break;
+            case std::ios_base::end:
+                pos = egptr() + off;
+                break;
+            default:
+                return pos_type ( off_type ( -1 ) );
+        }
+        if ( pos < eback() || pos > egptr() )
+            return pos_type ( off_type ( -1 ) );
+        setg ( eback(), pos, egptr() );
+        return pos - eback();
+    }
+
+    virtual pos_type seekpos ( pos_type pos, std::ios_base::openmode which ) override {
+        return seekoff ( pos, std::ios_base::beg, which );
+    }
+};
+
+/*
+ *  Single producer single consumer ring of decoded blocks.
+ *  The decoder thread only advances head and the consumer only advances tail.
+ *  The mutex is only taken to sleep when the ring is full or empty,
+ *  and by the other side to wake a sleeper, the sleeping flags tell it when to.
+ */
+struct MAudioStreamDecoder {
+    struct Block {
+        // new aligns it for floats, resized by the decoder thread when the chunk size grows
+        std::vector<char> data;
+        // set instead of data if the samples are used where they are stored
+        const char* mapped;
+        std::size_t size;
+        double position;
+        bool eof;
+    };
+    static constexpr std::size_t size = 4;
+    // the first block after a seek, small so it's decoded and heard quickly
+    static constexpr std::size_t fastStart = 0x1000;
+    Block blocks[size];
+    std::atomic<std::size_t> head{0};
+    std::atomic<std::size_t> tail{0};
+    bool held = false;
+    bool seeked = false;
+    std::atomic<std::size_t> chunk{0x4000};
+    std::atomic<std::uint64_t> chunks{0};
+    std::atomic<std::int64_t> time{0};
+    std::atomic<bool> quit{false};
+    std::atomic<bool> producerSleeping{false};
+    std::atomic<bool> consumerSleeping{false};
+    // tryRead() found the ring empty, wake the scheduler when the next block is ready
+    std::atomic<bool> waiting{false};
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+};
+
+MAudioStream::MAudioStream ( std::istream* stream, MByteSource source )
+    : m_interface{nullptr}, m_stream{stream}, m_source{std::move ( source )}, m_decoder{new MAudioStreamDecoder}
 {
     for ( auto iface: MAudioStreamInterface::interfaces() )
         if ( iface->valid ( m_stream ) ) {
@@ -49,55 +130,280 @@ MAudioStream::MAudioStream ( std::istream* stream ) : m_interface{nullptr}, m_st
                 break;
             }
         }
+    m_eof = m_decoderEof;
+}
+
+MAudioStream::MAudioStream ( std::istream* stream ) : MAudioStream{stream, {}}
+{
+}
+
+MAudioStream::MAudioStream ( std::streambuf* streambuf ) : MAudioStream{new MIStream{streambuf}, {}}
+{
 }
 
-MAudioStream::MAudioStream ( std::streambuf* streambuf ) : MAudioStream{new MIStream{streambuf}}
+MAudioStream::MAudioStream ( MByteSource source ) : MAudioStream{new MIStream{new MByteStreambuf{source}}, source}
 {
 }
 
-MAudioStream::MAudioStream ( const std::string& file ) : MAudioStream{new MIStream{file}}
+MAudioStream::MAudioStream ( MByteSource source, const std::string& file )
+    : MAudioStream{source ? new MIStream{new MByteStreambuf{source}} : new MIStream{file}, source}
 {
 }
 
-MAudioStream::MAudioStream ( const char* file ) : MAudioStream{new MIStream{file}}
+/*
+ *  Only regular files are mapped, opening a pipe just to find out it can't be mapped would consume the writer.
+ */
+static MByteSource map ( const std::string& file )
+{
+    std::error_code error;
+    if ( !std::filesystem::is_regular_file ( file, error ) )
+        return {};
+    return MByteSource::map ( file );
+}
+
+MAudioStream::MAudioStream ( const std::string& file ) : MAudioStream{map ( file ), file}
+{
+}
+
+MAudioStream::MAudioStream ( const char* file ) : MAudioStream{std::string{file}}
+{
+}
+
+static void stopDecoder ( MAudioStreamDecoder* d )
 {
+    if ( !d->thread.joinable() )
+        return;
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+        d->quit = true;
+    }
+    d->cond.notify_all();
+    d->thread.join();
+    d->quit = false;
 }
 
 MAudioStream::~MAudioStream()
 {
-    waitRead();
+    stopDecoder ( m_decoder );
     if ( m_interface )
         m_interface->fini ( this );
     delete m_stream;
+    delete m_decoder;
+}
+
+/*
+ *  Wakes the other side of the ring after head or tail moved, if it's sleeping.
+ *  Taking the mutex waits until the sleeper is inside wait(), so the notification isn't lost.
+ */
+static void wake ( MAudioStreamDecoder* d, const std::atomic<bool>& sleeping )
+{
+    if ( !sleeping )
+        return;
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+    }
+    d->cond.notify_all();
 }
 
 void MAudioStream::initRead()
 {
-    m_thread = std::thread { [this] {
-        if ( valid() )
-            m_interface->read(this);
+    auto d = m_decoder;
+    if ( !valid() || d->thread.joinable() || m_decoderEof )
+        return;
+    d->thread = std::thread { [this, d] {
+        for (;;) {
+            auto head = d->head.load ( std::memory_order_relaxed );
+            if ( head - d->tail.load ( std::memory_order_acquire ) == d->size ) {
+                std::unique_lock<std::mutex> lock{d->mutex};
+                // set before the condition is checked, so a consumer that misses it sees the new tail
+                d->producerSleeping = true;
+                d->cond.wait ( lock, [d, head] { return d->quit || head - d->tail.load() < d->size; } );
+                d->producerSleeping = false;
+            }
+            if ( d->quit )
+                return;
+            auto& block = d->blocks[head % d->size];
+            auto size = d->seeked ? d->fastStart : d->chunk.load ( std::memory_order_relaxed );
+            d->seeked = false;
+            auto start = std::chrono::steady_clock::now();
+            block.mapped = nullptr;
+            if ( m_sampleFormat == M_AUDIO_SAMPLE_INT16 ) {
+                block.size = size;
+                block.mapped = m_interface->map ( this, block.size );
+            }
+            if ( !block.mapped ) {
+                if ( block.data.size() < size )
+                    block.data.resize ( size );
+                if ( m_sampleFormat == M_AUDIO_SAMPLE_FLOAT32 )
+                    block.size = m_interface->readFloat ( this, reinterpret_cast<float*> ( block.data.data() ), size / sizeof(float) ) * sizeof(float);
+                else
+                    block.size = m_interface->read ( this, block.data.data(), size );
+            }
+            d->time += std::chrono::duration_cast<std::chrono::nanoseconds> ( std::chrono::steady_clock::now() - start ).count();
+            d->chunks++;
+            block.eof = m_decoderEof;
+            block.position = m_interface->tell ( this );
+            d->head.store ( head + 1 );
+            wake ( d, d->consumerSleeping );
+            if ( d->waiting.exchange ( false ) )
+                MAudioScheduler::wake();
+            if ( block.eof )
+                return;
+        }
     } };
 }
 
 void MAudioStream::waitRead()
 {
-    if ( m_thread.joinable() )
-        m_thread.join();
+    auto d = m_decoder;
+    if ( d->held ) {
+        d->held = false;
+        d->tail.store ( d->tail.load ( std::memory_order_relaxed ) + 1 );
+        wake ( d, d->producerSleeping );
+    }
+    buffer = nullptr;
+    buffer_size = 0;
+    if ( m_eof )
+        return;
+    initRead();
+    auto tail = d->tail.load ( std::memory_order_relaxed );
+    if ( d->head.load ( std::memory_order_acquire ) == tail ) {
+        std::unique_lock<std::mutex> lock{d->mutex};
+        d->consumerSleeping = true;
+        d->cond.wait ( lock, [d, tail] { return d->head.load() != tail; } );
+        d->consumerSleeping = false;
+    }
+    auto& block = d->blocks[tail % d->size];
+    d->held = true;
+    buffer = block.mapped ? block.mapped : block.data.data();
+    buffer_size = block.size;
+    m_position = block.position;
+    m_eof = block.eof;
+}
+
+bool MAudioStream::tryRead()
+{
+    auto d = m_decoder;
+    if ( !m_eof ) {
+        initRead();
+        auto next = d->tail.load ( std::memory_order_relaxed ) + d->held;
+        if ( d->head.load ( std::memory_order_acquire ) == next ) {
+            d->waiting = true;
+            // the decoder may have published the block before it could see the flag
+            if ( d->head.load() == next )
+                return false;
+            d->waiting = false;
+        }
+    }
+    waitRead();
+    return true;
+}
+
+void MAudioStream::setChunkSize ( std::size_t size )
+{
+    m_decoder->chunk = std::clamp<std::size_t> ( size, 0x400, 0x40000 ) / 8 * 8;
+}
+
+std::size_t MAudioStream::chunkSize ()
+{
+    return m_decoder->chunk;
+}
+
+std::uint64_t MAudioStream::decodedChunks ()
+{
+    return m_decoder->chunks;
+}
+
+std::chrono::nanoseconds MAudioStream::decodeTime ()
+{
+    return std::chrono::nanoseconds { m_decoder->time.load() };
+}
+
+std::size_t MAudioStream::decode ( char* data, std::size_t size )
+{
+    if ( !valid() )
+        return 0;
+    if ( m_decoder->thread.joinable() || m_decoder->held )
+        seek ( tell() );
+    std::size_t filled = 0;
+    while ( filled < size && !m_decoderEof ) {
+        std::size_t read;
+        if ( m_sampleFormat == M_AUDIO_SAMPLE_FLOAT32 )
+            read = m_interface->readFloat ( this, reinterpret_cast<float*> ( data + filled ), ( size - filled ) / sizeof(float) ) * sizeof(float);
+        else
+            read = m_interface->read ( this, data + filled, size - filled );
+        if ( !read )
+            break;
+        filled += read;
+    }
+    m_position = m_interface->tell ( this );
+    m_eof = m_decoderEof;
+    return filled;
+}
+
+MByteSource MAudioStream::pcm ()
+{
+    if ( !valid() || m_sampleFormat != M_AUDIO_SAMPLE_INT16 || !m_source )
+        return {};
+    if ( m_decoder->thread.joinable() || m_decoder->held )
+        seek ( tell() );
+    std::size_t size = -1;
+    auto data = m_interface->map ( this, size );
+    if ( !data )
+        return {};
+    m_position = m_interface->tell ( this );
+    m_eof = m_decoderEof;
+    return m_source.slice ( reinterpret_cast<const std::uint8_t*> ( data ) - m_source.data(), size );
 }
 
 void MAudioStream::seek ( std::chrono::duration< double > seconds )
 {
     if ( !valid() )
         return;
-    m_eof = false;
+    stopDecoder ( m_decoder );
+    m_decoder->head = 0;
+    m_decoder->tail = 0;
+    m_decoder->held = false;
+    m_decoder->seeked = true;
+    buffer = nullptr;
+    buffer_size = 0;
     m_interface->seek(this, seconds.count());
+    m_decoderEof = false;
+    m_eof = false;
+    m_position = m_interface->tell(this);
+}
+
+void MAudioStream::setSampleFormat ( MAudioSampleFormat format )
+{
+    if ( format == m_sampleFormat )
+        return;
+    bool decoding = m_decoder->thread.joinable() || m_decoder->held;
+    stopDecoder ( m_decoder );
+    m_sampleFormat = format;
+    // the decoder is ahead of the consumer, go back to where the consumer is
+    if ( decoding )
+        seek ( tell() );
 }
 
 std::chrono::duration< double > MAudioStream::tell ()
 {
     if ( !valid() )
         return {};
-    return std::chrono::duration< double > { m_interface->tell(this) };
+    return std::chrono::duration< double > { m_position };
+}
+
+std::chrono::duration< double > MAudioStream::length ()
+{
+    if ( !valid() )
+        return {};
+    return std::chrono::duration< double > { m_interface->length(this) };
+}
+
+std::int64_t MAudioStream::frames ()
+{
+    if ( !valid() )
+        return 0;
+    return m_interface->frames(this);
 }
 
 std::list<std::string> MAudioStream::getTag ( MAudioTag tag )
@@ -123,6 +429,44 @@ MAudioStreamInterface::~MAudioStreamInterface()
     interfaces().remove ( this );
 }
 
+std::size_t MAudioStreamInterface::readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const
+{
+    std::int16_t pcm[0x800];
+    std::size_t filled = 0;
+    while ( filled < count ) {
+        auto wanted = std::min ( count - filled, sizeof(pcm) / sizeof(*pcm) );
+        auto read = this->read ( audioStream, reinterpret_cast<char*> ( pcm ), wanted * sizeof(*pcm) ) / sizeof(*pcm);
+        for ( std::size_t i = 0; i < read; i++ )
+            buffer[filled + i] = pcm[i] * ( 1.0f / 32768.0f );
+        filled += read;
+        if ( read < wanted || audioStream->m_decoderEof )
+            break;
+    }
+    return filled;
+}
+
+const char* MAudioStreamInterface::map ( MAudioStream* audioStream, std::size_t& size ) const
+{
+    (void)audioStream;
+    (void)size;
+
+    return nullptr;
+}
+
+double MAudioStreamInterface::length ( MAudioStream* audioStream ) const
+{
+    (void)audioStream;
+
+    return 0;
+}
+
+std::int64_t MAudioStreamInterface::frames ( MAudioStream* audioStream ) const
+{
+    (void)audioStream;
+
+    return 0;
+}
+
 std::list<std::string> MAudioStreamInterface::getTag ( MAudioStream* audioStream, MAudioTag tag ) const
 {
     (void)audioStream;
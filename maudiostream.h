@@ -20,7 +20,9 @@
 #ifndef MAUDIOSTREAM_H
 #define MAUDIOSTREAM_H
 
-#include <mglobal.h>
+#include <mbytesource.h>
+#include <chrono>
+#include <cstdint>
 #include <list>
 #include <string>
 #include <thread>
@@ -39,6 +41,55 @@ enum MAudioTag {
     M_AUDIO_TAG_TOTAL_DISCS,
 };
 
+enum MAudioSampleFormat {
+    M_AUDIO_SAMPLE_INT16,
+    M_AUDIO_SAMPLE_FLOAT32,
+};
+
+/**
+ *  How a stream is buffered while it plays.
+ */
+struct MAudioBuffering {
+    /**
+     *  Number of buffers queued on the OpenAL source.
+     */
+    std::size_t buffers = 8;
+
+    /**
+     *  Bytes decoded at a time, each chunk fills one buffer.
+     */
+    std::size_t chunkSize = 0x4000;
+
+    /**
+     *  Grows the queue and the chunks after an underrun or when decoding a chunk
+     *  takes long compared to playing it, and shrinks them while decoding is fast.
+     */
+    bool adaptive = false;
+};
+
+/**
+ *  Counters of a playing stream.
+ */
+struct MAudioStreamingStatistics {
+    /**
+     *  How often the source ran out of buffers.
+     */
+    std::uint64_t underruns = 0;
+
+    /**
+     *  Chunks decoded and the time it took, @c decodeTime / @c chunks is the time per chunk.
+     */
+    std::uint64_t chunks = 0;
+    std::chrono::nanoseconds decodeTime{};
+
+    /**
+     *  Buffers queued at the moment and the current queue depth and chunk size.
+     */
+    std::size_t queued = 0;
+    std::size_t buffers = 0;
+    std::size_t chunkSize = 0;
+};
+
 class MAudioStreamInterface;
 class M_EXPORT MAudioStream
 {
@@ -47,6 +98,16 @@ class M_EXPORT MAudioStream
 public:
     explicit MAudioStream ( std::istream* stream );
     explicit MAudioStream ( std::streambuf* streambuf );
+
+    /**
+     *  Decodes @a source where it is, without copying it.
+     */
+    explicit MAudioStream ( MByteSource source );
+
+    /**
+     *  Maps @a file into memory and decodes it from there.
+     *  Files that can't be mapped, like pipes and devices, are read through a filebuf.
+     */
     explicit MAudioStream ( const std::string& file );
     explicit MAudioStream ( const char* file );
     MAudioStream ( const MAudioStream& ) = delete;
@@ -58,15 +119,90 @@ public:
     bool stereo () { return m_stereo; }
     bool valid () { return m_valid; }
 
-    char buffer[0x4000];
-    std::size_t buffer_size;
+    /**
+     *  @return  Format of the samples in @c buffer, 16-bit integers by default.
+     */
+    MAudioSampleFormat sampleFormat () { return m_sampleFormat; }
+
+    /**
+     *  Decodes to @a format from now on.
+     *  Blocks that were decoded ahead in the old format are dropped and decoded again.
+     */
+    void setSampleFormat ( MAudioSampleFormat format );
+
+    /**
+     *  Sets the number of bytes the decoder thread decodes at a time, 16 KiB by default.
+     *  It's clamped to 1 KiB - 256 KiB and rounded down to whole frames, it may be changed while decoding.
+     */
+    void setChunkSize ( std::size_t size );
+    std::size_t chunkSize ();
+
+    /**
+     *  @return  Number of blocks the decoder thread decoded.
+     */
+    std::uint64_t decodedChunks ();
 
+    /**
+     *  @return  Time the decoder thread spent decoding them.
+     */
+    std::chrono::nanoseconds decodeTime ();
+
+    /**
+     *  Block of decoded PCM data, set by waitRead().
+     *  It stays valid until the next call to waitRead() or seek().
+     */
+    const char* buffer = nullptr;
+    std::size_t buffer_size = 0;
+
+    /**
+     *  Starts the decoder thread unless it's already running.
+     *  The thread decodes blocks ahead into a ring buffer until the end of the stream.
+     */
     void initRead();
+
+    /**
+     *  Takes the next decoded block from the ring buffer, waiting for it if necessary.
+     */
     void waitRead();
 
+    /**
+     *  Takes the next decoded block like waitRead() if the decoder thread already decoded it.
+     *  Otherwise the decoder thread wakes the audio scheduler once it is decoded.
+     *  @return  False if it isn't decoded yet, @c buffer is left as it is then.
+     */
+    bool tryRead();
+
+    /**
+     *  Decodes up to @a size bytes straight into @a data on the calling thread,
+     *  without the decoder thread and its ring buffer.
+     *  Blocks the decoder thread decoded ahead are dropped first.
+     *  @return  Number of bytes written, less than @a size at the end of the stream.
+     */
+    std::size_t decode ( char* data, std::size_t size );
+
+    /**
+     *  Takes the rest of the stream as 16-bit samples where they are stored, without decoding or copying them.
+     *  @return  The samples or an empty source if the stream has to be decoded.
+     */
+    MByteSource pcm ();
+
+    /**
+     *  Stops the decoder thread and seeks to the sample nearest to @a seconds.
+     *  The first block decoded after it is short, so playback can resume sooner.
+     */
     void seek ( std::chrono::duration < double > seconds );
     std::chrono::duration < double > tell ();
 
+    /**
+     *  @return  Length of the whole stream or zero if it isn't known.
+     */
+    std::chrono::duration < double > length ();
+
+    /**
+     *  @return  Number of frames in the whole stream or 0 if it isn't known.
+     */
+    std::int64_t frames ();
+
     std::list<std::string> getTag ( MAudioTag tag );
     std::list<std::string> getTitle () { return getTag(M_AUDIO_TAG_TITLE); }
     std::list<std::string> getArtist () { return getTag(M_AUDIO_TAG_ARTIST); }
@@ -81,14 +217,21 @@ public:
     std::list<std::string> getTotalDiscs () { return getTag(M_AUDIO_TAG_TOTAL_DISCS); }
 
 private:
+    MAudioStream ( std::istream* stream, MByteSource source );
+    MAudioStream ( MByteSource source, const std::string& file );
+
     bool m_eof = true;
+    bool m_decoderEof = true;
+    double m_position = 0;
     int m_freq;
     bool m_stereo;
     void* m_userdata = nullptr;
     bool m_valid = false;
+    MAudioSampleFormat m_sampleFormat = M_AUDIO_SAMPLE_INT16;
     MAudioStreamInterface* m_interface;
     std::istream* m_stream;
-    std::thread m_thread{};
+    MByteSource m_source;
+    struct MAudioStreamDecoder* const m_decoder;
 };
 
 class M_EXPORT MAudioStreamInterface {
@@ -98,15 +241,42 @@ public:
     virtual bool valid ( std::istream* stream ) const = 0;
     virtual void init ( MAudioStream* audioStream ) const = 0;
     virtual void fini ( MAudioStream* audioStream ) const = 0;
-    virtual void read ( MAudioStream* audioStream ) const = 0;
+    /**
+     *  Decodes up to @a size bytes of PCM data into @a buffer.
+     *  Called from the decoder thread of @a audioStream.
+     *  @return  Number of bytes written.
+     */
+    virtual std::size_t read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const = 0;
+    /**
+     *  Decodes up to @a count interleaved float samples into @a buffer.
+     *  The default implementation converts the output of read().
+     *  @return  Number of samples written.
+     */
+    virtual std::size_t readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const;
+    /**
+     *  Takes up to @a size bytes of 16-bit PCM data where they are stored, so they don't have to be copied.
+     *  They must point into source() if it isn't empty and stay valid until fini().
+     *  The default implementation returns nullptr.
+     *  @param  size Set to the number of bytes taken.
+     *  @return  The data or nullptr if it has to be decoded with read().
+     */
+    virtual const char* map ( MAudioStream* audioStream, std::size_t& size ) const;
     virtual void seek ( MAudioStream* audioStream, double seconds ) const = 0;
     virtual double tell ( MAudioStream* audioStream ) const = 0;
+    /**
+     *  @return  Length of the stream in seconds or 0 if it isn't known.
+     */
+    virtual double length ( MAudioStream* audioStream ) const;
+    /**
+     *  @return  Number of frames in the stream or 0 if it isn't known.
+     */
+    virtual std::int64_t frames ( MAudioStream* audioStream ) const;
     virtual std::list<std::string> getTag ( MAudioStream* audioStream, MAudioTag tag ) const;
 
     static std::list<MAudioStreamInterface*>& interfaces();
 
 protected:
-    static void setEOF ( MAudioStream* audioStream, bool eof = true ) { audioStream->m_eof = eof; }
+    static void setEOF ( MAudioStream* audioStream, bool eof = true ) { audioStream->m_decoderEof = eof; }
     static void setFreq ( MAudioStream* audioStream, int freq ) { audioStream->m_freq = freq; }
     static void setStereo ( MAudioStream* audioStream, bool stereo ) { audioStream->m_stereo = stereo; }
     static void setUserData ( MAudioStream* audioStream, void* userdata ) { audioStream->m_userdata = userdata; }
@@ -114,6 +284,11 @@ protected:
     template < typename _Data >
     static _Data& userdata ( MAudioStream* audioStream ) { return *static_cast<_Data*> ( audioStream->m_userdata ); }
     static std::istream* stream ( MAudioStream* audioStream ) { return audioStream->m_stream; }
+    /**
+     *  @return  Memory the stream is decoded from, empty if there is only stream().
+     *  Reading it directly avoids the overhead of the istream.
+     */
+    static const MByteSource& source ( MAudioStream* audioStream ) { return audioStream->m_source; }
 };
 
 #endif // MAUDIOSTREAM_H
@@ -0,0 +1,89 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mbytesource.h"
+
+#include <mdebug.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+MByteSource MByteSource::map ( const std::string& file, bool writable )
+{
+    HANDLE handle = CreateFileA ( file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( handle == INVALID_HANDLE_VALUE ) {
+        mDebug() << file << ": No such file or directory.";
+        return {};
+    }
+    LARGE_INTEGER st;
+    if ( GetFileType ( handle ) != FILE_TYPE_DISK || !GetFileSizeEx ( handle, &st ) || !st.QuadPart ) {
+        CloseHandle ( handle );
+        return {};
+    }
+    std::size_t size = st.QuadPart;
+    HANDLE mapping = CreateFileMappingA ( handle, nullptr, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr );
+    CloseHandle ( handle );
+    void* data = mapping ? MapViewOfFile ( mapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, size ) : nullptr;
+    if ( mapping )
+        CloseHandle ( mapping );
+    if ( !data ) {
+        mDebug() << file << ": Can't map file.";
+        return {};
+    }
+    std::shared_ptr<const void> owner{data, [] ( const void* data ) { UnmapViewOfFile ( data ); }};
+    return { owner, static_cast<const std::uint8_t*> ( data ), size };
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MByteSource MByteSource::map ( const std::string& file, bool writable )
+{
+    int fd = open ( file.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 ) {
+        mDebug() << file << ": No such file or directory.";
+        return {};
+    }
+    struct stat st;
+    if ( fstat ( fd, &st ) < 0 || !S_ISREG ( st.st_mode ) || !st.st_size ) {
+        close ( fd );
+        return {};
+    }
+    std::size_t size = st.st_size;
+    void* data = mmap ( nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0 );
+    close ( fd );
+    if ( data == MAP_FAILED ) {
+        mDebug() << file << ": Can't map file.";
+        return {};
+    }
+    std::shared_ptr<const void> owner{data, [size] ( const void* data ) { munmap ( const_cast<void*> ( data ), size ); }};
+    return { owner, static_cast<const std::uint8_t*> ( data ), size };
+}
+#endif
+
+MByteSource MByteSource::slice ( std::size_t offset, std::size_t size ) const
+{
+    if ( offset > m_size )
+        return {};
+    if ( size > m_size - offset )
+        size = m_size - offset;
+    return { m_owner, m_data + offset, size };
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MBYTESOURCE_H
+#define MBYTESOURCE_H
+
+#include <mglobal.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ *  Read-only view of a block of memory.
+ *  Copies share the memory, it is released with the last copy.
+ */
+class M_EXPORT MByteSource
+{
+public:
+    MByteSource () = default;
+
+    /**
+     *  Views @a size bytes at @a data, kept alive by @a owner.
+     */
+    MByteSource ( std::shared_ptr<const void> owner, const std::uint8_t* data, std::size_t size )
+        : m_owner{std::move ( owner )}, m_data{data}, m_size{size} {}
+
+    /**
+     *  Maps @a file into memory.
+     *  If @a writable is true the pages may be written to, the changes are private to the process.
+     *  @return  The mapping or an empty source if the file can't be mapped.
+     */
+    static MByteSource map ( const std::string& file, bool writable = false );
+
+    const std::uint8_t* data () const { return m_data; }
+    std::size_t size () const { return m_size; }
+    bool empty () const { return !m_size; }
+    explicit operator bool () const { return m_data; }
+
+    /**
+     *  @return  View of @a size bytes at @a offset sharing the memory of this source.
+     */
+    MByteSource slice ( std::size_t offset, std::size_t size ) const;
+
+private:
+    std::shared_ptr<const void> m_owner;
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+#endif // MBYTESOURCE_H
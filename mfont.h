@@ -27,6 +27,11 @@ class MTexture;
 class M_EXPORT MFont : public MResource
 {
 public:
+    /**
+     *  Loaders of this type return instances of MFont or its subclasses.
+     */
+    static constexpr Type resourceType = Font;
+
     virtual std::uint16_t getSize() = 0;
     virtual bool setSize ( std::uint16_t size, std::uint16_t res = 0 ) = 0;
     virtual MTexture* render ( std::wstring text ) = 0;
@@ -34,4 +39,6 @@ public:
     MTexture* render ( std::string text );
 };
 
+template<> struct MResourceTyped<MFont> : std::true_type {};
+
 #endif // MFONT_H
@@ -19,9 +19,13 @@
 
 #include "mglobal.h"
 
+#include <cstdlib>
 #include <filesystem>
+#include <fstream>
 #include <mdl.h>
 #include <mdebug.h>
+#include <mresource.h>
+#include <mresourcepack.h>
 #include <mvideointerface.h>
 
 #include <alc.h>
@@ -44,6 +48,9 @@ void MLib::init ( int& argc, char**& argv )
         if ( f.path().filename().string()[0] != '.' )
             MDL::open(MLIB_LIBRARY_DIR + f.path().filename().string());
 
+    if ( exists ( MLIB_DATA_DIR "mlib.pack" ) )
+        MResourcePack::mount ( MLIB_DATA_DIR "mlib.pack", MLIB_DATA_DIR );
+
     auto device = alcOpenDevice ( nullptr );
     auto context = alcCreateContext ( device, nullptr );
     alcMakeContextCurrent ( context );
@@ -51,6 +58,11 @@ void MLib::init ( int& argc, char**& argv )
 
 void MLib::quit ( int status )
 {
+    if ( auto file = std::getenv ( "MLIB_RESOURCE_STATISTICS" ) ) {
+        std::ofstream stream{file};
+        MResource::dumpStatistics ( stream );
+    }
+
     auto video = MVideoInterface::get();
     if (video)
         video->fini();
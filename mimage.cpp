@@ -34,6 +34,14 @@ MImage::MImage ( MSize size, bool alpha, void* data )
 {
 }
 
+MImage::MImage ( MSize size, bool alpha, MByteSource source )
+    : m_size{size}
+    , m_alpha{alpha}
+    , m_data{const_cast<std::uint8_t*> ( source.data() )}
+    , m_source{std::move ( source )}
+{
+}
+
 MImage* mCopy ( const MImage* image )
 {
     if ( !image->data() )
@@ -47,13 +55,15 @@ MImage::MImage ( MImage&& other )
     : m_size{other.m_size}
     , m_alpha{other.m_alpha}
     , m_data{other.m_data}
+    , m_source{std::move ( other.m_source )}
 {
     other.m_data = nullptr;
 }
 
 MImage::~MImage()
 {
-    std::free ( m_data );
+    if ( !m_source )
+        std::free ( m_data );
 }
 
 MTexture* MImage::createTexture() const
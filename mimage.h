@@ -20,6 +20,7 @@
 #ifndef MIMAGE_H
 #define MIMAGE_H
 
+#include <mbytesource.h>
 #include <mresource.h>
 #include <msize.h>
 
@@ -27,7 +28,18 @@ class MTexture;
 class M_EXPORT MImage : public MResource
 {
 public:
+    /**
+     *  Loaders of this type return instances of MImage or its subclasses.
+     */
+    static constexpr Type resourceType = Image;
+
     MImage ( MSize size, bool alpha, void* data );
+
+    /**
+     *  Constructs an image using the pixels in @a source without copying them.
+     *  The source has to be writable.
+     */
+    MImage ( MSize size, bool alpha, MByteSource source );
     MImage ( const MImage& ) = delete;
     MImage ( MImage&& other );
     MImage& operator= ( const MImage& ) = delete;
@@ -38,6 +50,7 @@ public:
     bool hasAlpha() const { return m_alpha; }
     auto data() const { return static_cast<std::uint8_t*>(m_data); }
     auto stride() const { return (size().width() * ( hasAlpha() ? 4 : 3 ) + 3) &~3; }
+    virtual std::size_t memoryUsage() const override { return stride() * size().height(); }
 
     MTexture* createTexture() const;
 
@@ -45,8 +58,11 @@ private:
     MSize m_size;
     bool m_alpha;
     void* m_data;
+    MByteSource m_source;
 };
 
+template<> struct MResourceTyped<MImage> : std::true_type {};
+
 M_EXPORT MImage* mCopy ( const MImage* image );
 
 #endif // MIMAGE_H
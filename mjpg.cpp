@@ -20,60 +20,24 @@
 #include <mresourceloader.h>
 #include <mdebug.h>
 #include <mimage.h>
-#include <fstream>
 #include <cstring>
 #include <setjmp.h>
 #define boolean boolean__
 #include <jpeglib.h>
 
 class MJPG : public MResourceLoader {
-    virtual bool valid ( std::string file ) override;
-    virtual MResource* load ( std::string file ) override;
+    virtual std::list<std::string> magic() override { return { "\xff\xd8\xff" }; }
+    virtual MResource* load ( const MByteSource& source ) override;
     virtual MResource::Type type() override { return MResource::Image; }
     virtual std::string name() override { return "jpg"; }
 };
 
 M_EXPORT MJPG jpg;
 
-bool MJPG::valid ( std::string file )
-{
-    JOCTET magic[4];
-    bool inScan = false;
-    std::ifstream stream { file, std::ios::binary };
-    if ( !stream.is_open() )
-        mDebug() << file << ": No such file or directory.";
-    stream.read ( reinterpret_cast<char*> ( magic ), 2 );
-    if ( !stream.good() || magic[0] != 0xff || magic[1] != JPEG_EOI - 1 )
-        return false;
-    for (;;) {
-        stream.read ( reinterpret_cast<char*> ( magic ), 2 );
-        if ( !stream.good() || ( magic[0] != 0xff && !inScan ) )
-            return false;
-        if ( magic[0] != 0xff || magic[1] == 0xff ) {
-            stream.seekg ( -1, std::ios_base::cur );
-            continue;
-        }
-        if ( magic[1] == JPEG_EOI )
-            return true;
-        if ( inScan && !magic[1] )
-            continue;
-        if ( magic[1] >= JPEG_RST0 && magic[1] < JPEG_EOI )
-            continue;
-        stream.read ( reinterpret_cast<char*> ( magic + 2 ), 2 );
-        if ( !stream.good() )
-            return false;
-        if ( !stream.seekg ( ( magic[2] << 8 ) + magic[3] - 2, std::ios_base::cur ) )
-            return false;
-        if ( magic[1] == JPEG_EOI + 1 )
-            inScan = true;
-    }
-}
-
-MResource* MJPG::load ( std::string file )
+MResource* MJPG::load ( const MByteSource& source )
 {
     struct source_mgr : jpeg_source_mgr {
-        std::ifstream* stream;
-        JOCTET buffer[0x1000];
+        JOCTET eoi[2];
     }* src;
     jpeg_decompress_struct cinfo;
     struct error_mgr : jpeg_error_mgr {
@@ -96,15 +60,10 @@ MResource* MJPG::load ( std::string file )
     src->init_source = [] ( j_decompress_ptr ) {};
     src->fill_input_buffer = [] ( j_decompress_ptr cinfo ) {
         auto src = static_cast<source_mgr*> ( cinfo->src );
-        src->stream->read ( reinterpret_cast<char*> ( src->buffer ), sizeof(src->buffer) );
-        src->next_input_byte = src->buffer;
-        if ( src->stream->good() )
-            src->bytes_in_buffer = src->stream->gcount();
-        else {
-            src->buffer[0] = 0xff;
-            src->buffer[1] = JPEG_EOI;
-            src->bytes_in_buffer = 2;
-        }
+        src->eoi[0] = 0xff;
+        src->eoi[1] = JPEG_EOI;
+        src->next_input_byte = src->eoi;
+        src->bytes_in_buffer = 2;
         return 1;
     };
     src->skip_input_data = [] ( j_decompress_ptr cinfo, long num_bytes ) {
@@ -119,9 +78,8 @@ MResource* MJPG::load ( std::string file )
     };
     src->resync_to_restart = jpeg_resync_to_restart;
     src->term_source = [] ( j_decompress_ptr ) {};
-    src->stream = new std::ifstream { file, std::ios_base::binary };
-    src->bytes_in_buffer = 0;
-    src->next_input_byte = nullptr;
+    src->bytes_in_buffer = source.size();
+    src->next_input_byte = source.data();
     jpeg_read_header ( &cinfo, true );
     bool raw = cinfo.num_components == 4;
     cinfo.out_color_space = raw ? JCS_CMYK : JCS_RGB;
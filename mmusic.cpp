@@ -19,141 +19,72 @@
 
 #include "mmusic.h"
 
-#include <array>
-#include <al.h>
-
-namespace al {
-    enum format {
-        MONO8 = AL_FORMAT_MONO8,
-        MONO16 = AL_FORMAT_MONO16,
-        STEREO8 = AL_FORMAT_STEREO8,
-        STEREO16 = AL_FORMAT_STEREO16,
-    };
-}
+#include <maudioscheduler_p.h>
 
 using namespace std;
-using namespace al;
 
-static volatile bool m_pause{};
-static volatile bool m_stop{};
-static thread m_thread;
-static unsigned int source{};
+static shared_ptr<MAudioStreamPlayer> player;
+static bool paused{};
+static MAudioBuffering musicBuffering;
 
 void MMusic::play_sync ( MAudioStream* stream )
 {
-    stream->initRead();
-
-    al::format format = stream->stereo() ? STEREO16 : MONO16;
-    constexpr size_t n_buffers = 8;
-    int state;
-    array<unsigned int,n_buffers> buffers;
-
-    alGenSources(1, &source);
-    alGenBuffers(n_buffers, buffers.data());
-
-    alSourcei(source, AL_SOURCE_RELATIVE, AL_TRUE);
-    alSourcef(source, AL_ROLLOFF_FACTOR, 0 );
-
-    alSourcei(source, AL_BUFFER, 0);
-
-    for ( ALuint buffer: buffers ) {
-        stream->waitRead();
-        alBufferData(buffer, format, stream->buffer, stream->buffer_size, stream->freq());
-        stream->initRead();
-    }
-    alSourceQueueBuffers(source, n_buffers, buffers.data());
-
-    if (!m_pause)
-        alSourcePlay(source);
-
-    while (!stream->eof()) {
-        ALint processed;
-        alGetSourcei(source, AL_BUFFERS_PROCESSED, &processed);
-        ALuint buffers[processed];
-
-        alSourceUnqueueBuffers(source, processed, buffers);
-        for ( ALuint buffer: buffers ) {
-            stream->waitRead();
-            alBufferData(buffer, format, stream->buffer, stream->buffer_size, stream->freq());
-            if (stream->eof())
-                break;
-            stream->initRead();
-        }
-        alSourceQueueBuffers(source, processed, buffers);
-
-        alGetSourcei(source, AL_SOURCE_STATE, &state);
-
-        if (m_stop) {
-            if (state != AL_STOPPED) {
-                alSourceStop(source);
-                alGetSourcei(source, AL_SOURCE_STATE, &state);
-            }
-            stream->waitRead();
-            break;
-        }
-
-        if (m_pause && state == AL_PLAYING)
-            alSourcePause(source);
-
-        if (!m_pause && state != AL_PLAYING)
-            alSourcePlay(source);
-
-        if (stream->eof())
-            break;
-
-        this_thread::sleep_for(0.2s);
-    }
-
-    while (state != AL_STOPPED) {
-        if (m_stop) {
-            alSourceStop(source);
-            break;
-        }
-
-        alGetSourcei(source, AL_SOURCE_STATE, &state);
-
-        if (m_pause && state == AL_PLAYING)
-            alSourcePause(source);
-
-        if (!m_pause && state != AL_PLAYING)
-            alSourcePlay(source);
-
-        this_thread::sleep_for(0.2s);
-    }
-
-    alDeleteBuffers(n_buffers, buffers.data());
-    alDeleteSources(1, &source);
-    source = 0;
+    play ( stream );
+    player->wait();
 }
 
 void MMusic::play ( MAudioStream* stream )
 {
-    if (source)
+    if (player)
         stop();
-    m_thread = thread{play_sync,stream};
+    player = make_shared<MAudioStreamPlayer> ( stream );
+    player->setBuffering ( musicBuffering );
+    if (paused)
+        player->pause();
+    MAudioScheduler::add ( player );
 }
 
 void MMusic::stop()
 {
-    m_stop = true;
-    m_thread.join();
-    m_stop = false;
-    m_thread = thread{};
+    if (!player)
+        return;
+    player->stop();
+    player->wait();
+    player = nullptr;
 }
 
 void MMusic::pause()
 {
-    m_pause = true;
+    paused = true;
+    if (player)
+        player->pause();
 }
 
 void MMusic::resume()
 {
-    m_pause = false;
+    paused = false;
+    if (player)
+        player->play();
 }
 
 bool MMusic::playing()
 {
-    int state;
-    alGetSourcei(source, AL_SOURCE_STATE, &state);
-    return state == AL_PLAYING;
+    return player && player->playing();
+}
+
+void MMusic::setBuffering ( const MAudioBuffering& buffering )
+{
+    musicBuffering = buffering;
+    if (player)
+        player->setBuffering ( buffering );
+}
+
+MAudioBuffering MMusic::buffering()
+{
+    return musicBuffering;
+}
+
+MAudioStreamingStatistics MMusic::statistics()
+{
+    return player ? player->statistics() : MAudioStreamingStatistics{};
 }
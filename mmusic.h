@@ -31,6 +31,17 @@ M_EXPORT void stop ();
 M_EXPORT void pause ();
 M_EXPORT void resume ();
 M_EXPORT bool playing ();
+
+/**
+ *  Sets how the music is buffered, it applies to the current stream too.
+ */
+M_EXPORT void setBuffering ( const MAudioBuffering& buffering );
+M_EXPORT MAudioBuffering buffering ();
+
+/**
+ *  @return  Counters of the stream that is playing, all zero if none is.
+ */
+M_EXPORT MAudioStreamingStatistics statistics ();
 }
 
 #endif // MMUSIC_H
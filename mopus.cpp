@@ -23,6 +23,7 @@
 #include <mdebug.h>
 
 #include <opusfile.h>
+#include <cmath>
 #include <istream>
 
 static struct OpusInterface : public MAudioStreamInterface
@@ -30,9 +31,12 @@ static struct OpusInterface : public MAudioStreamInterface
     virtual bool valid ( std::istream* stream ) const;
     virtual void init ( MAudioStream* audioStream ) const;
     virtual void fini ( MAudioStream* audioStream ) const;
-    virtual void read ( MAudioStream* audioStream ) const;
+    virtual std::size_t read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const;
+    virtual std::size_t readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const override;
     virtual void seek ( MAudioStream* audioStream, double seconds ) const;
     virtual double tell ( MAudioStream* audioStream ) const;
+    virtual double length ( MAudioStream* audioStream ) const override;
+    virtual std::int64_t frames ( MAudioStream* audioStream ) const override;
     virtual std::list<std::string> getTag ( MAudioStream* audioStream, MAudioTag tag ) const override;
 } iface;
 
@@ -83,8 +87,14 @@ void OpusInterface::init ( MAudioStream* audioStream ) const
         },
         nullptr,
     };
-    stream ( audioStream ) ->seekg(0);
-    if ( auto opusFile = op_open_callbacks ( audioStream, &callbacks, nullptr, 0, nullptr ) ) {
+    OggOpusFile* opusFile;
+    if ( auto& data = source ( audioStream ) )
+        opusFile = op_open_memory ( data.data(), data.size(), nullptr );
+    else {
+        stream ( audioStream ) ->seekg(0);
+        opusFile = op_open_callbacks ( audioStream, &callbacks, nullptr, 0, nullptr );
+    }
+    if ( opusFile ) {
         auto head = op_head ( opusFile, -1 );
         setEOF ( audioStream, false );
         setFreq ( audioStream, 48000 );
@@ -101,7 +111,7 @@ void OpusInterface::fini ( MAudioStream* audioStream ) const
 
 void OpusInterface::seek ( MAudioStream* audioStream, double seconds ) const
 {
-    op_pcm_seek ( &userdata<OggOpusFile> ( audioStream ), seconds * 48000.0 );
+    op_pcm_seek ( &userdata<OggOpusFile> ( audioStream ), std::llround ( seconds * 48000.0 ) );
 }
 
 double OpusInterface::tell ( MAudioStream* audioStream ) const
@@ -109,26 +119,78 @@ double OpusInterface::tell ( MAudioStream* audioStream ) const
     return op_pcm_tell ( &userdata<OggOpusFile> ( audioStream ) ) / 48000.0;
 }
 
-void OpusInterface::read ( MAudioStream* audioStream ) const
+double OpusInterface::length ( MAudioStream* audioStream ) const
+{
+    auto length = op_pcm_total ( &userdata<OggOpusFile> ( audioStream ), -1 );
+    return length < 0 ? 0 : length / 48000.0;
+}
+
+std::int64_t OpusInterface::frames ( MAudioStream* audioStream ) const
+{
+    auto frames = op_pcm_total ( &userdata<OggOpusFile> ( audioStream ), -1 );
+    return frames < 0 ? 0 : frames;
+}
+
+std::size_t OpusInterface::read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const
 {
-    audioStream->buffer_size = 0;
+    // op_read counts samples, op_read_stereo downmixes anything with more than two channels
+    std::size_t frame = audioStream->stereo() ? 2 * sizeof(opus_int16) : sizeof(opus_int16);
+    std::size_t filled = 0;
     long read;
     do {
-        read = op_read ( &userdata<OggOpusFile> ( audioStream ),
-                         reinterpret_cast<opus_int16*> (audioStream->buffer + audioStream->buffer_size),
-                         sizeof(audioStream->buffer) - audioStream->buffer_size, nullptr );
+        auto pcm = reinterpret_cast<opus_int16*> ( buffer + filled );
+        int samples = ( size - filled ) / sizeof(opus_int16);
+        if ( audioStream->stereo() )
+            read = op_read_stereo ( &userdata<OggOpusFile> ( audioStream ), pcm, samples );
+        else
+            read = op_read ( &userdata<OggOpusFile> ( audioStream ), pcm, samples, nullptr );
+        if ( read <= 0 )
+            switch ( read ) {
+                case 0:
+                    setEOF ( audioStream );
+                    return filled;
+                case OP_HOLE:
+                    mDebug(ERROR) << "OP_HOLE";
+                    read = 0;
+                    break;
+                default:
+                    mDebug(ERROR) << "op_read failed";
+                    setEOF ( audioStream );
+                    return filled;
+            }
+        else
+            filled += read * frame;
+    } while ( filled + read * frame < size );
+    return filled;
+}
+
+std::size_t OpusInterface::readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const
+{
+    std::size_t channels = audioStream->stereo() ? 2 : 1;
+    std::size_t filled = 0;
+    while ( filled + channels <= count ) {
+        int read;
+        if ( audioStream->stereo() )
+            read = op_read_float_stereo ( &userdata<OggOpusFile> ( audioStream ), buffer + filled, count - filled );
+        else
+            read = op_read_float ( &userdata<OggOpusFile> ( audioStream ), buffer + filled, count - filled, nullptr );
         if ( read <= 0 )
             switch ( read ) {
                 case 0:
                     setEOF ( audioStream );
-                    return;
+                    return filled;
                 case OP_HOLE:
                     mDebug(ERROR) << "OP_HOLE";
                     break;
+                default:
+                    mDebug(ERROR) << "op_read_float failed";
+                    setEOF ( audioStream );
+                    return filled;
             }
         else
-            audioStream->buffer_size += read;
-    } while ( audioStream->buffer_size + read < sizeof(audioStream->buffer) );
+            filled += read * channels;
+    }
+    return filled;
 }
 
 std::list<std::string> OpusInterface::getTag ( MAudioStream* audioStream, MAudioTag tag ) const
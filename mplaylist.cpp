@@ -19,30 +19,22 @@
 
 #include "mplaylist.h"
 
-#include <al.h>
+#include <maudioscheduler_p.h>
 
-namespace al {
-    enum format {
-        MONO8 = AL_FORMAT_MONO8,
-        MONO16 = AL_FORMAT_MONO16,
-        STEREO8 = AL_FORMAT_STEREO8,
-        STEREO16 = AL_FORMAT_STEREO16,
-    };
-}
+#include <algorithm>
+#include <numeric>
 
 using namespace std;
 using namespace sigxx;
 using namespace chrono;
-using namespace this_thread;
-using namespace al;
 
 static slot<bool> slotFinished = [] ( bool stop ) {
     auto playlist = slotFinished.userdata<MPlaylist>();
-    if ( playlist->stoppingAfter() != 0 && stop == false)
+    if ( playlist->stoppingAfter() != 0 && stop == false && playlist->stopped() )
         playlist->playNext();
 };
 
-MPlaylist::MPlaylist ()
+MPlaylist::MPlaylist () : m_random{std::random_device{}()}
 {
     finished.connect(slotFinished);
 }
@@ -52,218 +44,333 @@ MPlaylist::~MPlaylist ()
     clear();
 }
 
-void MPlaylist::playSync ()
+size_t MPlaylist::find ( MAudioStream* stream )
 {
-    if ( stopped() )
-        return;
-
-    al::format format = m_stream->stereo() ? STEREO16 : MONO16;
-
-    m_stream->initRead();
-
-    alGenSources(1, &m_source);
-    alGenBuffers(m_buffers.size(), m_buffers.data());
+    return find_if ( m_playlist.begin(), m_playlist.end(), [stream] ( const Entry* entry ) { return entry->stream == stream; } ) - m_playlist.begin();
+}
 
-    alSourcei(m_source, AL_SOURCE_RELATIVE, AL_TRUE);
-    alSourcef(m_source, AL_ROLLOFF_FACTOR, 0 );
+size_t MPlaylist::following ( size_t index )
+{
+    auto size = m_playlist.size();
+    size_t position = index < size ? ( m_shuffled ? m_rank[index] + 1 : index + 1 ) : 0;
+    if ( position == size ) {
+        if ( !loop )
+            return size;
+        position = 0;
+    }
+    return m_shuffled ? m_order[position] : position;
+}
 
-    alSourcei(m_source, AL_BUFFER, 0);
+MAudioStream* MPlaylist::open ( Entry& entry )
+{
+    if ( !entry.stream )
+        entry.stream = new MAudioStream{entry.file};
+    return entry.stream;
+}
 
-    for ( ALuint buffer: m_buffers ) {
-        m_stream->waitRead();
-        alBufferData(buffer, format, m_stream->buffer, m_stream->buffer_size, m_stream->freq());
-        m_stream->initRead();
+void MPlaylist::close ( MAudioStream* stream )
+{
+    auto i = find ( stream );
+    if ( i < m_playlist.size() && !m_playlist[i]->file.empty() ) {
+        delete stream;
+        m_playlist[i]->stream = nullptr;
     }
+    else
+        stream->seek(0s);
+}
 
-    if ( m_stop ) {
-        m_stream->waitRead();
-        m_stream->seek(0s);
+void MPlaylist::finish ( bool stop )
+{
+    {
+        lock_guard<mutex> lock{m_mutex};
+        // the player already rewound the upcoming streams
+        for ( auto stream: m_upcoming )
+            close ( stream );
+        m_upcoming.clear();
+        close ( m_stream );
         m_stream = nullptr;
-        alDeleteBuffers(m_buffers.size(), m_buffers.data());
-        alDeleteSources(1, &m_source);
-        m_thread.detach();
-        return;
     }
-
-    alSourceQueueBuffers(m_source, m_buffers.size(), m_buffers.data());
-
-    m_thread.detach();
-    if ( !m_pause )
-        resume();
+    finished(stop);
 }
 
-void MPlaylist::resumeSync ()
+MAudioStream* MPlaylist::upcoming ( MAudioStream* stream )
 {
-    if ( stopped() )
-        return;
-
-    int state = AL_PLAYING;
-    alSourcePlay(m_source);
-
-    while ( !m_stream->eof() ) {
-        al::format format = m_stream->stereo() ? STEREO16 : MONO16;
-        alSourcef(m_source, AL_GAIN, volume);
-        ALint processed;
-        alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &processed);
-        decltype(m_buffers) buffers;
-
-        alSourceUnqueueBuffers(m_source, processed, buffers.data());
-        for ( int i = 0; i < processed; i++ ) {
-            m_stream->waitRead();
-            alBufferData(buffers[i], format, m_stream->buffer, m_stream->buffer_size, m_stream->freq());
-            if (m_stream->eof())
-                break;
-            m_stream->initRead();
-        }
-        alSourceQueueBuffers(m_source, processed, buffers.data());
-
-        alGetSourcei(m_source, AL_SOURCE_STATE, &state);
-
-        if ( m_stop ) {
-            if ( state != AL_STOPPED ) {
-                alSourceStop(m_source);
-                state = AL_STOPPED;
-            }
-            m_stream->waitRead();
-            break;
-        }
-
-        if ( m_pause ) {
-            alSourcePause(m_source);
-            m_thread.detach();
-            return;
-        }
-
-        if ( state != AL_PLAYING )
-            alSourcePlay(m_source);
+    lock_guard<mutex> lock{m_mutex};
+    if ( m_stopAfter + 1 && m_stopAfter <= m_upcoming.size() )
+        return nullptr;
+    auto index = find ( stream );
+    if ( index == m_playlist.size() )
+        return nullptr;
+    index = following ( index );
+    if ( index == m_playlist.size() )
+        return nullptr;
+    auto& next = *m_playlist[index];
+    // a stream can only be read by one decoder at a time
+    if ( next.stream && ( next.stream == m_stream || std::find ( m_upcoming.begin(), m_upcoming.end(), next.stream ) != m_upcoming.end() ) )
+        return nullptr;
+    if ( !open ( next )->valid() ) {
+        close ( next.stream );
+        return nullptr;
+    }
+    m_upcoming.push_back ( next.stream );
+    return next.stream;
+}
 
-        if ( !m_stream->eof() )
-            this_thread::sleep_for(0.1s);
+void MPlaylist::advance ( MAudioStream* previous )
+{
+    {
+        lock_guard<mutex> lock{m_mutex};
+        close ( previous );
+        m_stream = m_upcoming.front();
+        m_upcoming.pop_front();
+        m_current = find ( m_stream );
+        if ( m_stopAfter && m_stopAfter + 1 )
+            m_stopAfter--;
     }
+    finished(false);
+}
 
-    while ( state != AL_STOPPED ) {
-        if ( m_stop ) {
-            alSourceStop(m_source);
-            break;
-        }
+shared_ptr<MAudioStreamPlayer> MPlaylist::player ()
+{
+    lock_guard<mutex> lock{m_mutex};
+    return m_player;
+}
 
-        if ( m_pause ) {
-            alSourcePause(m_source);
-            m_thread.detach();
+/*
+ *  Stops the player and waits for it. A player that ended by itself just then
+ *  may have started the next song already, so that one is stopped too.
+ */
+void MPlaylist::halt ()
+{
+    for ( auto current = player(); current; ) {
+        current->stop();
+        current->wait();
+        auto next = player();
+        if ( next == current )
             return;
-        }
-
-        alGetSourcei(m_source, AL_SOURCE_STATE, &state);
-
-        if ( !m_pause && state != AL_PLAYING )
-            alSourcePlay(m_source);
-
-        sleep_for(0.2s);
+        current = next;
     }
+}
 
-    alDeleteBuffers(m_buffers.size(), m_buffers.data());
-    alDeleteSources(1, &m_source);
+size_t MPlaylist::size ()
+{
+    lock_guard<mutex> lock{m_mutex};
+    return m_playlist.size();
+}
 
-    m_stream->waitRead();
-    m_stream->seek(0s);
-    m_stream = nullptr;
-    m_thread.detach();
-    finished(m_stop);
+bool MPlaylist::empty ()
+{
+    lock_guard<mutex> lock{m_mutex};
+    return m_playlist.empty();
 }
 
 size_t MPlaylist::getCurrentIndex ()
 {
-    int index = 0;
-    auto i = m_playlist.begin();
-    while ( i++ != m_current )
-        index++;
-    return index;
+    return m_current;
 }
 
 void MPlaylist::setCurrentIndex ( size_t index )
 {
-    index %= m_playlist.size();
-    m_current = m_playlist.begin();
-    while ( index --> 0 )
-        m_current++;
+    lock_guard<mutex> lock{m_mutex};
+    if ( m_playlist.empty() )
+        return;
+    m_current = index % m_playlist.size();
 }
 
 void MPlaylist::insert ( size_t index, MAudioStream* stream )
 {
-    if ( index >= m_playlist.size() )
-        m_playlist.push_back(stream);
-    else {
-        auto i = m_playlist.begin();
-        while ( index --> 0 )
-            i++;
-        m_playlist.insert(i, stream);
+    vector<Entry*> entries;
+    entries.emplace_back ( new Entry{stream, {}} );
+    insert(index, entries);
+}
+
+void MPlaylist::insert ( size_t index, const string& file )
+{
+    vector<Entry*> entries;
+    entries.emplace_back ( new Entry{nullptr, file} );
+    insert(index, entries);
+}
+
+void MPlaylist::insert ( size_t index, const vector<string>& files )
+{
+    vector<Entry*> entries;
+    entries.reserve ( files.size() );
+    for ( auto& file: files )
+        entries.emplace_back ( new Entry{nullptr, file} );
+    insert(index, entries);
+}
+
+void MPlaylist::insert ( size_t index, const vector<Entry*>& entries )
+{
+    lock_guard<mutex> lock{m_mutex};
+    index = min ( index, m_playlist.size() );
+    auto count = entries.size();
+    m_playlist.insert ( m_playlist.begin() + index, entries.begin(), entries.end() );
+    // an unselected current index is size() and stays so
+    if ( m_current >= index )
+        m_current += count;
+    if ( m_shuffled ) {
+        for ( auto& i: m_order )
+            i += i >= index ? count : 0;
+        m_rank.insert ( m_rank.begin() + index, count, 0 );
+        // the new songs are merged at random places among the songs after the current one,
+        // the songs that were already in the order keep their order
+        size_t first = m_current < m_playlist.size() ? m_rank[m_current] + 1 : 0;
+        vector<size_t> added ( count );
+        iota ( added.begin(), added.end(), index );
+        std::shuffle ( added.begin(), added.end(), m_random );
+        vector<size_t> rest ( m_order.begin() + first, m_order.end() );
+        m_order.resize ( first );
+        auto a = added.begin();
+        auto r = rest.begin();
+        while ( a != added.end() || r != rest.end() ) {
+            size_t left = added.end() - a;
+            size_t total = left + ( rest.end() - r );
+            if ( uniform_int_distribution<size_t>{1, total} ( m_random ) <= left )
+                m_order.push_back ( *a++ );
+            else
+                m_order.push_back ( *r++ );
+        }
+        for ( size_t i = first; i < m_order.size(); i++ )
+            m_rank[m_order[i]] = i;
     }
 }
 
 void MPlaylist::remove ( size_t index )
 {
-    if ( empty() )
-        return;
-    auto i = m_playlist.begin();
-    while ( index --> 0 ) {
-        i++;
-        if ( i == m_playlist.end() )
+    remove(index, 1);
+}
+
+void MPlaylist::remove ( size_t index, size_t count )
+{
+    bool playing = false;
+    {
+        lock_guard<mutex> lock{m_mutex};
+        if ( index >= m_playlist.size() )
             return;
+        count = min ( count, m_playlist.size() - index );
+        for ( auto i = index; i < index + count; i++ ) {
+            auto stream = m_playlist[i]->stream;
+            if ( stream && ( stream == m_stream || std::find ( m_upcoming.begin(), m_upcoming.end(), stream ) != m_upcoming.end() ) )
+                playing = true;
+        }
     }
-    if ( m_current == i )
-        m_current++;
-    if ( m_stream == *i ) {
-        stop();
-        while ( playing() )
-            sleep_for(0.1s);
+    if ( playing )
+        halt();
+    lock_guard<mutex> lock{m_mutex};
+    if ( index >= m_playlist.size() )
+        return;
+    count = min ( count, m_playlist.size() - index );
+    for ( auto i = index; i < index + count; i++ ) {
+        delete m_playlist[i]->stream;
+        delete m_playlist[i];
+    }
+    m_playlist.erase ( m_playlist.begin() + index, m_playlist.begin() + index + count );
+    // a removed current song selects the one after it
+    if ( m_current >= index + count )
+        m_current -= count;
+    else if ( m_current > index )
+        m_current = index;
+    if ( m_shuffled ) {
+        // drop the removed songs from the order and renumber the rest
+        m_rank.resize ( m_playlist.size() );
+        size_t position = 0;
+        for ( auto i: m_order ) {
+            if ( i >= index && i < index + count )
+                continue;
+            if ( i >= index + count )
+                i -= count;
+            m_order[position] = i;
+            m_rank[i] = position++;
+        }
+        m_order.resize ( position );
     }
-    delete *i;
-    m_playlist.erase(i);
 }
 
 void MPlaylist::clear ()
 {
-    stop();
-    while ( playing() )
-        sleep_for(0.1s);
-    for ( auto stream: m_playlist )
-        delete stream;
+    halt();
+    lock_guard<mutex> lock{m_mutex};
+    for ( auto entry: m_playlist ) {
+        delete entry->stream;
+        delete entry;
+    }
     m_playlist.clear();
+    m_order.clear();
+    m_rank.clear();
+    m_current = 0;
+}
+
+void MPlaylist::shuffle ( unsigned int seed )
+{
+    lock_guard<mutex> lock{m_mutex};
+    m_random.seed ( seed );
+    m_order.resize ( m_playlist.size() );
+    for ( size_t i = 0; i < m_order.size(); i++ )
+        m_order[i] = i;
+    for ( size_t i = m_order.size(); i > 1; i-- )
+        swap ( m_order[i - 1], m_order[uniform_int_distribution<size_t>{0, i - 1} ( m_random )] );
+    m_rank.resize ( m_order.size() );
+    for ( size_t i = 0; i < m_order.size(); i++ )
+        m_rank[m_order[i]] = i;
+    m_shuffled = true;
+}
+
+void MPlaylist::unshuffle ()
+{
+    lock_guard<mutex> lock{m_mutex};
+    m_shuffled = false;
+    m_order.clear();
+    m_rank.clear();
 }
 
 void MPlaylist::playCurrent ()
 {
-    stop();
-    if ( m_current == m_playlist.end() )
-        return;
-    while ( playing() )
-        sleep_for(0.1s);
-    m_pause = false;
-    m_stop = false;
-    m_stream = *m_current;
-    m_thread = thread{&MPlaylist::playSync,this};
+    halt();
+    shared_ptr<MAudioStreamPlayer> player;
+    MAudioBuffering buffering;
+    {
+        lock_guard<mutex> lock{m_mutex};
+        if ( m_current >= m_playlist.size() )
+            return;
+        m_stream = open ( *m_playlist[m_current] );
+        player = make_shared<MAudioStreamPlayer> ( m_stream, &volume, [this] ( bool stop ) { finish ( stop ); } );
+        player->setNext ( [this] ( MAudioStream* stream ) { return upcoming ( stream ); },
+                          [this] ( MAudioStream* previous ) { advance ( previous ); } );
+        buffering = m_buffering;
+        m_player = player;
+    }
+    player->setBuffering ( buffering );
+    MAudioScheduler::add ( player );
 }
 
 void MPlaylist::playNext ()
 {
     stop();
-    if ( m_current == m_playlist.end() )
-        m_current = m_playlist.begin();
-    else
-        m_current++;
-    if ( m_current == m_playlist.end() ) {
-        if ( loop )
-            m_current = m_playlist.begin();
-        else {
-            m_current--;
+    {
+        lock_guard<mutex> lock{m_mutex};
+        auto next = following ( m_current );
+        if ( next == m_playlist.size() )
             return;
-        }
+        m_current = next;
     }
     if ( m_stopAfter && m_stopAfter + 1 )
         m_stopAfter--;
     playCurrent();
 }
 
+void MPlaylist::playRandom ()
+{
+    size_t index;
+    {
+        lock_guard<mutex> lock{m_mutex};
+        if ( m_playlist.empty() )
+            return;
+        index = uniform_int_distribution<size_t>{0, m_playlist.size() - 1} ( m_random );
+    }
+    play(index);
+}
+
 void MPlaylist::play ( size_t index )
 {
     stop();
@@ -275,27 +382,58 @@ void MPlaylist::seek ( duration < double > seconds )
 {
     if ( stopped() )
         playCurrent();
-    if ( stopped() )
+    auto current = player();
+    if ( stopped() || !current )
         return;
-    m_stream->seek(seconds);
+    current->seek(seconds);
 }
 
 duration < double > MPlaylist::tell ()
 {
-    if ( stopped() )
+    auto current = player();
+    if ( stopped() || !current )
         return 0s;
-    return m_stream->tell();
+    return current->tell();
+}
+
+void MPlaylist::setBuffering ( const MAudioBuffering& buffering )
+{
+    shared_ptr<MAudioStreamPlayer> current;
+    {
+        lock_guard<mutex> lock{m_mutex};
+        m_buffering = buffering;
+        current = m_player;
+    }
+    if ( current )
+        current->setBuffering ( buffering );
+}
+
+MAudioStreamingStatistics MPlaylist::statistics ()
+{
+    auto current = player();
+    return current ? current->statistics() : MAudioStreamingStatistics{};
+}
+
+void MPlaylist::stop ()
+{
+    if ( auto current = player() )
+        current->stop();
+}
+
+void MPlaylist::pause ()
+{
+    if ( auto current = player() )
+        current->pause();
 }
 
 void MPlaylist::resume ()
 {
-    m_pause = false;
-    if ( !paused() )
-        return;
-    m_thread = thread{&MPlaylist::resumeSync,this};
+    if ( auto current = player() )
+        current->play();
 }
 
 bool MPlaylist::playing ()
 {
-    return m_thread.joinable ();
+    auto current = player();
+    return current && current->playing();
 }
@@ -21,7 +21,12 @@
 #define MPLAYLIST_H
 
 #include <maudiostream.h>
-#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
 #include <sigxx.hh>
 
 class M_EXPORT MPlaylist
@@ -59,16 +64,25 @@ public:
     void insert ( std::size_t index, std::streambuf* streambuf ) { insert(index, new MAudioStream{streambuf}); }
 
     /**
-     *  Loads a song and inserts it before @index.
+     *  Inserts a song before @index.
+     *  The file is only opened shortly before the song plays and closed after it,
+     *  so a long playlist doesn't keep a decoder for every song.
      *  @param  file Path to the song.
      */
-    void insert ( std::size_t index, const std::string& file ) { insert(index, new MAudioStream{file}); }
+    void insert ( std::size_t index, const std::string& file );
 
     /**
-     *  Loads a song and inserts it before @index.
+     *  Inserts a song before @index.
+     *  The file is only opened shortly before the song plays and closed after it.
      *  @param  file Path to the song.
      */
-    void insert ( std::size_t index, const char* file ) { insert(index, new MAudioStream{file}); }
+    void insert ( std::size_t index, const char* file ) { insert(index, std::string{file}); }
+
+    /**
+     *  Inserts songs before @index, like inserting each file on its own but in one step.
+     *  @param  files Paths to the songs.
+     */
+    void insert ( std::size_t index, const std::vector<std::string>& files );
 
     /**
      *  Removes a song.
@@ -76,6 +90,12 @@ public:
      */
     void remove ( std::size_t index );
 
+    /**
+     *  Removes @a count songs starting at @a index.
+     *  If the current song is removed it selects the song after them.
+     */
+    void remove ( std::size_t index, std::size_t count );
+
     /**
      *  Removes all the songs from the playlist.
      */
@@ -94,12 +114,12 @@ public:
     /**
      *  @return  The number of songs in the playlist.
      */
-    std::size_t size () { return m_playlist.size(); }
+    std::size_t size ();
 
     /**
      *  @return  True if the playlist is empty.
      */
-    bool empty () { return m_playlist.empty(); }
+    bool empty ();
 
     /**
      *  Plays the song at @a index.
@@ -116,23 +136,44 @@ public:
      *  If no song is selected it plays the first song in the playlist.
      *  If the current song is the last in the playlist and @c loop is false it calls @c stop() and returns.
      *  If the current song is the last in the playlist and @c loop is true it plays the first song in the playlist.
+     *  When shuffled, first and last refer to the shuffled order.
      */
     void playNext ();
 
     /**
      *  Selects a random song and plays it.
+     *  The random engine is seeded differently for every playlist unless shuffle() is given a seed.
      */
-    void playRandom () { play(rand() % m_playlist.size()); }
+    void playRandom ();
+
+    /**
+     *  Plays the songs in a random order instead of the playlist order.
+     *  The order is computed once and kept when songs are inserted or removed,
+     *  so every song plays once before any song repeats.
+     *  Inserted songs are placed at random among the songs after the current one.
+     *  @param  seed Seeds the random engine, the same seed gives the same order.
+     */
+    void shuffle ( unsigned int seed = std::random_device{}() );
+
+    /**
+     *  Plays the songs in the playlist order again.
+     */
+    void unshuffle ();
+
+    /**
+     *  @return  True if the songs play in a shuffled order.
+     */
+    bool shuffled () { return m_shuffled; }
 
     /**
      *  Stops playing and rewinds the current song.
      */
-    void stop () { m_stop = true; }
+    void stop ();
 
     /**
      *  Pauses the current song.
      */
-    void pause () { m_pause = true; }
+    void pause ();
 
     /**
      *  Resumes the current song.
@@ -154,6 +195,8 @@ public:
 
     /**
      *  A song finished playing.
+     *  The next song is decoded into the same source before that happens,
+     *  so it follows without a gap if it has the same rate and channels.
      *  @param  1 True if it was stopped using @c stop().
      */
     sigxx::signal<bool> finished{this};
@@ -172,19 +215,47 @@ public:
      */
     std::size_t stoppingAfter () { return m_stopAfter; }
 
+    /**
+     *  Sets how the songs are buffered, it applies to the current song too.
+     */
+    void setBuffering ( const MAudioBuffering& buffering );
+    MAudioBuffering buffering () { return m_buffering; }
+
+    /**
+     *  @return  Counters since playback last started, songs that follow without a gap keep counting.
+     */
+    MAudioStreamingStatistics statistics ();
+
 private:
-    void playSync ();
-    void resumeSync ();
-
-    volatile bool m_pause;
-    volatile bool m_stop;
-    std::thread m_thread;
-    unsigned int m_source;
-    std::array<unsigned int, 8> m_buffers;
-    std::list<MAudioStream*> m_playlist;
-    std::list<MAudioStream*>::iterator m_current = m_playlist.end();
-    MAudioStream* volatile m_stream = nullptr;
+    struct Entry {
+        MAudioStream* stream;
+        std::string file;
+    };
+
+    void insert ( std::size_t index, const std::vector<Entry*>& entries );
+    std::size_t find ( MAudioStream* stream );
+    std::size_t following ( std::size_t index );
+    MAudioStream* open ( Entry& entry );
+    void close ( MAudioStream* stream );
+    void finish ( bool stop );
+    MAudioStream* upcoming ( MAudioStream* stream );
+    void advance ( MAudioStream* previous );
+    std::shared_ptr<class MAudioStreamPlayer> player ();
+    void halt ();
+
+    // replaced on the scheduler thread when the next song starts, guarded by m_mutex
+    std::shared_ptr<class MAudioStreamPlayer> m_player;
+    std::vector<Entry*> m_playlist;
+    std::atomic<std::size_t> m_current{0};
+    std::vector<std::size_t> m_order;
+    std::vector<std::size_t> m_rank;
+    std::mt19937 m_random;
+    bool m_shuffled = false;
+    std::atomic<MAudioStream*> m_stream{nullptr};
+    std::list<MAudioStream*> m_upcoming;
+    std::mutex m_mutex;
     std::size_t m_stopAfter = -1;
+    MAudioBuffering m_buffering;
 };
 
 #endif // MPLAYLIST_H
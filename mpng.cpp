@@ -20,36 +20,35 @@
 #include <mresourceloader.h>
 #include <mdebug.h>
 #include <mimage.h>
-#include <fstream>
+#include <cstring>
 #include <png.h>
 
 class MPNG : public MResourceLoader {
-    virtual bool valid ( std::string file ) override;
-    virtual MResource* load ( std::string file ) override;
+    virtual std::list<std::string> magic() override { return { "\x89PNG\r\n\x1a\n" }; }
+    virtual MResource* load ( const MByteSource& source ) override;
     virtual MResource::Type type() override { return MResource::Image; }
     virtual std::string name() override { return "png"; }
 };
 
 M_EXPORT MPNG png;
 
-bool MPNG::valid ( std::string file )
-{
-    png_byte header[8];
-    std::ifstream stream { file, std::ios::binary };
-    if ( !stream.is_open() )
-        mDebug() << file << ": No such file or directory.";
-    stream.read ( reinterpret_cast<char*> ( header ), 8 );
-    return stream.good() && !png_sig_cmp ( header, 0, 8 );
-}
+struct Reader {
+    const png_byte* data;
+    png_size_t size;
+};
 
 static void readData ( png_structp png, png_bytep data, png_size_t length )
 {
     png_voidp a = png_get_io_ptr ( png );
-    std::ifstream* stream = static_cast<std::ifstream*> ( a );
-    stream->read ( reinterpret_cast<char*> ( data ), length );
+    Reader* reader = static_cast<Reader*> ( a );
+    if ( length > reader->size )
+        png_error ( png, "Unexpected end of file" );
+    std::memcpy ( data, reader->data, length );
+    reader->data += length;
+    reader->size -= length;
 }
 
-MResource* MPNG::load ( std::string file )
+MResource* MPNG::load ( const MByteSource& source )
 {
     png_structp png = png_create_read_struct ( PNG_LIBPNG_VER_STRING, NULL, NULL, NULL );
     if ( !png )
@@ -63,8 +62,8 @@ MResource* MPNG::load ( std::string file )
         png_destroy_read_struct ( &png, &info, nullptr );
         return nullptr;
     }
-    std::ifstream stream { file, std::ios::binary };
-    png_set_read_fn ( png, &stream, readData );
+    Reader reader { source.data(), source.size() };
+    png_set_read_fn ( png, &reader, readData );
     png_read_info ( png, info );
     png_uint_32 width, height;
     int bitDepth, colorType, interlaceMethod;
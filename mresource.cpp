@@ -19,43 +19,577 @@
 
 #include "mresource.h"
 
+#include <mresourcecache_p.h>
+#include <mdebug.h>
 #include <mresourceloader.h>
+#include <mresourcepack.h>
+#include <mresourcewatcher_p.h>
+#include <mthreadpool.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
 
-static std::map< std::string, MResource* > map;
+/*
+ *  Entries are never deleted, so readers can look them up without locking.
+ *  Everything that changes the registry is serialized by the mutex.
+ */
+struct MResourceEntry {
+    std::string file;
+    std::size_t hash;
+    std::uint32_t index;
+    std::atomic<MResource*> resource{nullptr};
+    std::atomic<std::size_t> refcount{0};
+    // steady clock ticks, refreshed at most once per useGranularity
+    std::atomic<std::chrono::steady_clock::rep> lastUse{0};
+    std::atomic<bool> evicted{false};
+    std::atomic<int> type{-1};
+    // generation of the resource in the high half, handles acquired in it in the low half
+    std::atomic<std::uint64_t> holders{0};
+    // replaced by reload(), freed by unload() and evict() or once the handles of their generation are released
+    struct Retired {
+        MResource* resource;
+        std::uint32_t generation;
+        std::uint32_t holders;
+    };
+    std::list<Retired> retired;
+    std::size_t size = 0;
+};
 
-bool MResource::load ( std::string file )
+/*
+ *  Entries live in fixed size segments which are never moved,
+ *  so an MResourceId is just an index into them.
+ */
+static constexpr std::size_t segmentSize = 0x400;
+static constexpr std::size_t segmentCount = 0x1000;
+
+/*
+ *  Open addressing hash table with linear probing.
+ *  When it grows the entries are copied into a new table which is then published,
+ *  old tables are kept because readers might still be probing them.
+ */
+struct Table {
+    explicit Table ( std::size_t capacity ) : mask{capacity - 1}, slots{new std::atomic<MResourceEntry*>[capacity]} {
+        for ( std::size_t i = 0; i < capacity; i++ )
+            slots[i].store ( nullptr, std::memory_order_relaxed );
+    }
+    std::size_t mask;
+    std::unique_ptr< std::atomic<MResourceEntry*>[] > slots;
+};
+
+struct Budget {
+    std::size_t limit = std::numeric_limits<std::size_t>::max();
+    std::size_t usage = 0;
+};
+
+static std::atomic<Table*> table{new Table{0x100}};
+static std::vector< std::unique_ptr<Table> > tables;
+static std::atomic<MResourceEntry*> segments[segmentCount];
+static std::atomic<std::uint32_t> count;
+static std::unordered_map< const MResource*, MResourceEntry* > entries;
+static std::map< int, Budget > budgets;
+
+/*
+ *  Lookup statistics are counted in shards picked per thread,
+ *  so lookups on different threads don't write to the same cache line.
+ */
+struct alignas(64) Counter {
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+};
+
+static constexpr std::size_t counterCount = 16;
+static Counter counters[counterCount];
+static constexpr auto useGranularity = std::chrono::steady_clock::duration{std::chrono::milliseconds{1}}.count();
+static std::mutex mutex;
+static bool watching = false;
+
+sigxx::signal<std::string,MResource*> MResource::loaded{nullptr};
+sigxx::signal<std::string,MResource*> MResource::reloaded{nullptr};
+
+static Counter& counter()
 {
-    for ( auto loader: MResourceLoader::loaders() ) {
-        if ( !loader->valid ( file ) )
+    static std::atomic<std::size_t> next{0};
+    static thread_local Counter& shard = counters[next.fetch_add ( 1, std::memory_order_relaxed ) % counterCount];
+    return shard;
+}
+
+static void hit()
+{
+    counter().hits.fetch_add ( 1, std::memory_order_relaxed );
+}
+
+static void miss()
+{
+    counter().misses.fetch_add ( 1, std::memory_order_relaxed );
+}
+
+static void touch ( MResourceEntry* entry )
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    if ( now - entry->lastUse.load ( std::memory_order_relaxed ) >= useGranularity )
+        entry->lastUse.store ( now, std::memory_order_relaxed );
+}
+
+static MResourceEntry* entryAt ( std::uint32_t index )
+{
+    return &segments[index / segmentSize].load ( std::memory_order_acquire )[index % segmentSize];
+}
+
+static MResourceEntry* findEntry ( std::string_view file )
+{
+    auto hash = std::hash<std::string_view>{} ( file );
+    auto t = table.load ( std::memory_order_acquire );
+    for ( auto i = hash;; i++ ) {
+        auto entry = t->slots[i & t->mask].load ( std::memory_order_acquire );
+        if ( !entry )
+            return nullptr;
+        if ( entry->hash == hash && entry->file == file )
+            return entry;
+    }
+}
+
+static void insertEntry ( Table* t, MResourceEntry* entry )
+{
+    for ( auto i = entry->hash;; i++ )
+        if ( !t->slots[i & t->mask].load ( std::memory_order_relaxed ) ) {
+            t->slots[i & t->mask].store ( entry, std::memory_order_release );
+            return;
+        }
+}
+
+static MResourceEntry* createEntry ( const std::string& file )
+{
+    if ( auto entry = findEntry ( file ) )
+        return entry;
+    std::uint32_t index = count.load ( std::memory_order_relaxed );
+    if ( index == segmentSize * segmentCount ) {
+        mDebug ( ERROR ) << "Too many resources";
+        return nullptr;
+    }
+    if ( index % segmentSize == 0 )
+        segments[index / segmentSize].store ( new MResourceEntry[segmentSize], std::memory_order_release );
+    auto entry = entryAt ( index );
+    entry->file = file;
+    entry->index = index;
+    entry->hash = std::hash<std::string_view>{} ( entry->file );
+    auto t = table.load ( std::memory_order_relaxed );
+    if ( ( index + 1 ) * 2 > t->mask + 1 ) {
+        auto grown = new Table{( t->mask + 1 ) * 2};
+        for ( std::uint32_t i = 0; i < index; i++ )
+            insertEntry ( grown, entryAt ( i ) );
+        tables.emplace_back ( t );
+        table.store ( grown, std::memory_order_release );
+        t = grown;
+    }
+    insertEntry ( t, entry );
+    count.store ( index + 1, std::memory_order_release );
+    return entry;
+}
+
+static void evict ( MResourceEntry* entry )
+{
+    auto res = entry->resource.exchange ( nullptr );
+    budgets[entry->type].usage -= entry->size;
+    entries.erase ( res );
+    delete res;
+    entry->size = 0;
+    for ( auto& retired: entry->retired ) {
+        entries.erase ( retired.resource );
+        delete retired.resource;
+    }
+    entry->retired.clear();
+}
+
+/*
+ *  Evicts the least recently used resources of @a type without handles until it fits its budget.
+ *  @a keep is never evicted, so a resource that is being returned stays valid.
+ */
+static void shrink ( int type, MResourceEntry* keep = nullptr )
+{
+    auto& budget = budgets[type];
+    while ( budget.usage > budget.limit ) {
+        MResourceEntry* lru = nullptr;
+        for ( std::uint32_t i = 0; i < count; i++ ) {
+            auto entry = entryAt ( i );
+            if ( entry == keep || !entry->resource || entry->refcount || entry->type != type )
+                continue;
+            if ( !lru || entry->lastUse < lru->lastUse )
+                lru = entry;
+        }
+        if ( !lru )
+            return;
+        evict ( lru );
+        lru->evicted = true;
+    }
+}
+
+static void install ( MResourceEntry* entry, MResource* res, MResourceLoader* loader )
+{
+    entry->type = loader->type();
+    entry->size = res->memoryUsage();
+    touch ( entry );
+    entry->resource.store ( res, std::memory_order_release );
+    entry->evicted = false;
+    entries[res] = entry;
+    budgets[entry->type].usage += entry->size;
+    shrink ( entry->type, entry );
+    if ( watching )
+        MResourceWatcher::add ( entry->file );
+}
+
+static MResource* decode ( const std::string& file, MResourceLoader*& found )
+{
+    auto source = MResourcePack::find ( file );
+    if ( !source )
+        source = MByteSource::map ( file );
+    if ( !source )
+        return nullptr;
+    for ( auto loader: MResourceLoader::find ( source ) ) {
+        if ( !loader->valid ( source ) )
             continue;
-        auto res = loader->load ( file );
+        MResourceLoader::Statistics statistics;
+        auto start = std::chrono::steady_clock::now();
+        statistics.count = 1;
+        statistics.bytesRead = source.size();
+        auto res = MResourceCache::load ( source, loader );
+        if ( res )
+            statistics.cacheHits = 1;
+        else {
+            res = loader->load ( source );
+            if ( res )
+                MResourceCache::store ( source, loader, res );
+        }
+        if ( res )
+            statistics.bytesDecoded = res->memoryUsage();
+        else
+            statistics.failures = 1;
+        statistics.time = std::chrono::steady_clock::now() - start;
+        loader->record ( statistics );
         if ( !res )
             continue;
-        map[file] = res;
+        found = loader;
+        return res;
+    }
+    return nullptr;
+}
+
+static MResource* loadResource ( const std::string& file )
+{
+    if ( auto entry = findEntry ( file ) )
+        if ( auto res = entry->resource.load ( std::memory_order_acquire ) ) {
+            hit();
+            return res;
+        }
+    miss();
+    MResourceLoader* loader;
+    auto res = decode ( file, loader );
+    if ( !res )
+        return nullptr;
+    std::lock_guard<std::mutex> lock{mutex};
+    auto entry = createEntry ( file );
+    if ( !entry ) {
+        delete res;
+        return nullptr;
+    }
+    if ( auto loaded = entry->resource.load() ) {
+        delete res;
+        return loaded;
+    }
+    install ( entry, res, loader );
+    return res;
+}
+
+bool MResource::load ( std::string file )
+{
+    return loadResource ( file );
+}
+
+/*
+ *  Shared by the workers of loadAll(), it outlives the call if a worker starts late.
+ */
+struct MResourceBatch {
+    void run ();
+
+    std::vector<std::string> files;
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> loaded{0};
+    std::size_t finished = 0;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+void MResourceBatch::run ()
+{
+    for ( std::size_t i; ( i = next++ ) < files.size(); ) {
+        if ( loadResource ( files[i] ) )
+            loaded++;
+        std::lock_guard<std::mutex> lock{mutex};
+        if ( ++finished == files.size() )
+            condition.notify_all();
+    }
+}
+
+std::size_t MResource::loadAll ( const std::vector<std::string>& files )
+{
+    auto batch = std::make_shared<MResourceBatch>();
+    batch->files = files;
+    auto workers = std::min<std::size_t> ( MThreadPool::global().size(), files.size() );
+    // the calling thread is one of the workers, so this also works from inside the pool
+    for ( std::size_t i = 1; i < workers; i++ )
+        MThreadPool::global().push ( [batch] { batch->run(); } );
+    batch->run();
+    std::unique_lock<std::mutex> lock{batch->mutex};
+    batch->condition.wait ( lock, [&batch] { return batch->finished == batch->files.size(); } );
+    return batch->loaded;
+}
+
+std::shared_future<MResource*> MResource::loadAsync ( std::string file, int priority )
+{
+    auto task = std::make_shared< std::packaged_task<MResource*()> > ( [file] {
+        auto res = loadResource ( file );
+        loaded ( file, res );
+        return res;
+    } );
+    std::shared_future<MResource*> future = task->get_future();
+    MThreadPool::global().push ( [task] { (*task)(); }, priority );
+    return future;
+}
+
+bool MResource::reload ( std::string file )
+{
+    MResourceLoader* loader;
+    auto res = decode ( file, loader );
+    if ( !res )
+        return false;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto entry = createEntry ( file );
+        if ( !entry ) {
+            delete res;
+            return false;
+        }
+        auto old = entry->resource.load();
+        if ( old )
+            budgets[entry->type].usage -= entry->size;
+        install ( entry, res, loader );
+        if ( old ) {
+            // handles acquired from now on count towards the new resource,
+            // those acquired before may still use the old one, which stays in entries so unload() finds it
+            auto state = entry->holders.load();
+            while ( !entry->holders.compare_exchange_weak ( state, ( ( state >> 32 ) + 1 ) << 32 ) );
+            entry->retired.push_back ( { old, std::uint32_t ( state >> 32 ), std::uint32_t ( state ) } );
+        }
+    }
+    reloaded ( file, res );
+    return true;
+}
+
+bool MResource::setWatching ( bool watch )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if ( watch == watching )
+        return true;
+    if ( !watch ) {
+        MResourceWatcher::stop();
+        watching = false;
         return true;
     }
-    return false;
+    if ( !MResourceWatcher::start() )
+        return false;
+    watching = true;
+    for ( std::uint32_t i = 0; i < count; i++ )
+        if ( entryAt ( i )->resource )
+            MResourceWatcher::add ( entryAt ( i )->file );
+    return true;
 }
 
 void MResource::unload ( std::string file )
 {
-    auto i = map.find ( file );
-    delete i->second;
-    map.erase ( i );
+    std::lock_guard<std::mutex> lock{mutex};
+    auto entry = findEntry ( file );
+    if ( !entry )
+        return;
+    evict ( entry );
+    entry->evicted = false;
 }
 
 void MResource::unload ( const MResource* res )
 {
-    for ( auto i = map.begin(); i != map.end(); i++ )
-        if ( i->second == res )
-            map.erase ( i );
-    delete res;
+    std::unique_lock<std::mutex> lock{mutex};
+    auto i = entries.find ( res );
+    if ( i == entries.end() ) {
+        lock.unlock();
+        delete res;
+        return;
+    }
+    auto entry = i->second;
+    if ( res != entry->resource.load() ) {
+        // an older version replaced by reload()
+        entry->retired.remove_if ( [res] ( const MResourceEntry::Retired& retired ) { return retired.resource == res; } );
+        entries.erase ( i );
+        delete res;
+        return;
+    }
+    evict ( entry );
+    entry->evicted = false;
+}
+
+MResourceId::MResourceId ( std::string_view file )
+{
+    auto entry = findEntry ( file );
+    if ( !entry ) {
+        std::lock_guard<std::mutex> lock{mutex};
+        entry = createEntry ( std::string{file} );
+    }
+    if ( entry )
+        m_index = entry->index;
+}
+
+MResourceEntry* MResource::find ( std::string_view file )
+{
+    return findEntry ( file );
+}
+
+MResourceEntry* MResource::entry ( MResourceId id )
+{
+    if ( id.m_index >= count.load ( std::memory_order_acquire ) )
+        return nullptr;
+    return entryAt ( id.m_index );
 }
 
-template<>
-MResource* MResource::get ( std::string file )
+MResource* MResource::get ( MResourceEntry* entry )
 {
-    return map[file];
+    if ( !entry ) {
+        miss();
+        return nullptr;
+    }
+    auto res = entry->resource.load ( std::memory_order_acquire );
+    if ( res )
+        hit();
+    else if ( entry->evicted )
+        res = loadResource ( entry->file );
+    else
+        miss();
+    touch ( entry );
+    return res;
+}
+
+MResource* MResource::get ( MResourceEntry* entry, Type type )
+{
+    auto res = get ( entry );
+    if ( res && entry->type.load ( std::memory_order_relaxed ) != type )
+        return nullptr;
+    return res;
+}
+
+MResourceEntry* MResource::acquire ( const std::string& file, std::uint32_t& generation )
+{
+    auto entry = findEntry ( file );
+    if ( !entry ) {
+        std::lock_guard<std::mutex> lock{mutex};
+        entry = createEntry ( file );
+    }
+    return acquire ( entry, generation );
+}
+
+MResourceEntry* MResource::acquire ( MResourceEntry* entry, std::uint32_t& generation )
+{
+    if ( entry ) {
+        entry->refcount++;
+        generation = entry->holders.fetch_add ( 1 ) >> 32;
+    }
+    return entry;
+}
+
+void MResource::release ( MResourceEntry* entry, std::uint32_t generation )
+{
+    if ( !entry )
+        return;
+    bool last = !--entry->refcount;
+    bool current = false;
+    auto state = entry->holders.load();
+    while ( std::uint32_t ( state >> 32 ) == generation && !current )
+        current = entry->holders.compare_exchange_weak ( state, state - 1 );
+    if ( current && ( !last || !entry->resource.load ( std::memory_order_relaxed ) ) )
+        return;
+    std::lock_guard<std::mutex> lock{mutex};
+    if ( !current ) {
+        // the handle was acquired before a reload, the resource it could see may be freed now
+        auto i = std::find_if ( entry->retired.begin(), entry->retired.end(), [generation] ( const MResourceEntry::Retired& retired ) {
+            return retired.generation == generation;
+        } );
+        if ( i != entry->retired.end() && !--i->holders ) {
+            entries.erase ( i->resource );
+            delete i->resource;
+            entry->retired.erase ( i );
+        }
+    }
+    if ( last && entry->resource.load ( std::memory_order_relaxed ) )
+        shrink ( entry->type );
+}
+
+void MResource::setBudget ( Type type, std::size_t bytes )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    budgets[type].limit = bytes;
+    shrink ( type );
+}
+
+std::size_t MResource::budget ( Type type )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return budgets[type].limit;
+}
+
+std::size_t MResource::usage ( Type type )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return budgets[type].usage;
+}
+
+MResource::Statistics MResource::statistics ()
+{
+    Statistics statistics{0, 0};
+    for ( auto& counter: counters ) {
+        statistics.hits += counter.hits.load ( std::memory_order_relaxed );
+        statistics.misses += counter.misses.load ( std::memory_order_relaxed );
+    }
+    return statistics;
+}
+
+void MResource::dumpStatistics ( std::ostream& stream )
+{
+    auto totals = statistics();
+    stream << "{\n";
+    stream << "    \"hits\": " << totals.hits << ",\n";
+    stream << "    \"misses\": " << totals.misses << ",\n";
+    stream << "    \"loaders\": {";
+    bool first = true;
+    for ( auto loader: MResourceLoader::loaders() ) {
+        auto statistics = loader->statistics();
+        stream << ( first ? "\n" : ",\n" );
+        first = false;
+        stream << "        \"" << loader->name() << "\": {\n";
+        stream << "            \"count\": " << statistics.count << ",\n";
+        stream << "            \"failures\": " << statistics.failures << ",\n";
+        stream << "            \"cacheHits\": " << statistics.cacheHits << ",\n";
+        stream << "            \"bytesRead\": " << statistics.bytesRead << ",\n";
+        stream << "            \"bytesDecoded\": " << statistics.bytesDecoded << ",\n";
+        stream << "            \"timeUs\": " << std::chrono::duration_cast<std::chrono::microseconds> ( statistics.time ).count() << "\n";
+        stream << "        }";
+    }
+    stream << ( first ? "}\n" : "\n    }\n" );
+    stream << "}\n";
 }
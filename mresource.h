@@ -21,7 +21,53 @@
 #define MDATAFILE_H
 
 #include <mglobal.h>
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <mresourcepreload.h>
+#include <sigxx.hh>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template< typename Resource > class MResourceHandle;
+
+/**
+ *  True for classes that declare their own @c resourceType.
+ *  Specialize it next to the class, subclasses inherit @c resourceType
+ *  but not the specialization, so get() uses a dynamic_cast for them.
+ */
+template< typename Resource >
+struct MResourceTyped : std::false_type {};
+
+/**
+ *  Interned path to a resource.
+ *  The path is looked up once, the resource is then accessed by index.
+ */
+class M_EXPORT MResourceId
+{
+public:
+    MResourceId () = default;
+    explicit MResourceId ( std::string_view file );
+
+    /**
+     *  @return  The resource or nullptr if the file is not loaded.
+     */
+    template< typename Resource = struct MResource >
+    Resource* get () const;
+
+    std::uint32_t index () const { return m_index; }
+    explicit operator bool () const { return m_index != invalid; }
+    bool operator== ( MResourceId other ) const { return m_index == other.m_index; }
+    bool operator!= ( MResourceId other ) const { return m_index != other.m_index; }
+
+private:
+    friend struct MResource;
+    static constexpr std::uint32_t invalid = -1;
+    std::uint32_t m_index = invalid;
+};
 
 struct M_EXPORT MResource
 {
@@ -31,22 +77,185 @@ struct M_EXPORT MResource
         Image,
     };
 
+    struct Statistics {
+        std::uint64_t hits;
+        std::uint64_t misses;
+    };
+
     MResource() = default;
     MResource(const MResource&) = delete;
     virtual ~MResource() = 0;
 
+    /**
+     *  @return  Approximate number of bytes held by the resource.
+     */
+    virtual std::size_t memoryUsage () const { return 0; }
+
     static bool load ( std::string file );
+
+    /**
+     *  Loads @a files on the workers of the global thread pool and the calling thread,
+     *  each worker takes the next file once it's done with the previous one.
+     *  Blocks until all of them are loaded.
+     *  @return  Number of files that were loaded.
+     */
+    static std::size_t loadAll ( const std::vector<std::string>& files );
+
+    /**
+     *  Loads @a file on a worker thread of the global thread pool.
+     *  Files with a higher @a priority are loaded first.
+     *  @return  Future holding the loaded resource or nullptr if loading failed.
+     */
+    static std::shared_future<MResource*> loadAsync ( std::string file, int priority = 0 );
+
+    /**
+     *  Prepares loading the files in @a manifest, see MResourcePreload.
+     *  @return  The preload, owned by the caller, call MResourcePreload::start() on it.
+     */
+    static MResourcePreload* preload ( const std::list<MResourcePreload::Entry>& manifest );
+
     static void unload ( std::string file );
     static void unload ( const MResource* res );
+
+    /**
+     *  Loads @a file again and replaces the loaded resource.
+     *  Handles return the new resource from now on. Pointers to the old one stay valid
+     *  until the file is unloaded or evicted. If handles to the file existed at that time,
+     *  the old resource is deleted sooner, once the last of them is released.
+     *  @return  False if the file couldn't be loaded, the old resource is kept in that case.
+     */
+    static bool reload ( std::string file );
+
+    /**
+     *  Watches the files of loaded resources and reloads them
+     *  on a worker thread of the global thread pool when they change.
+     *  @return  False if watching is not supported on this system.
+     */
+    static bool setWatching ( bool watch );
+
+    /**
+     *  Returns the resource loaded from @a file.
+     *  If it was evicted from the cache it is loaded again.
+     *  The pointer stays valid until the resource is unloaded or evicted,
+     *  use MResourceHandle to keep it from being evicted.
+     *  Safe to call from any thread, looking up a loaded resource doesn't lock or allocate.
+     */
     template< typename Resource = MResource >
-    static Resource* get ( std::string file ) {
-        return dynamic_cast<Resource*> ( get ( file ) );
+    static Resource* get ( std::string_view file ) {
+        return cast<Resource> ( find ( file ) );
+    }
+
+    /**
+     *  Returns the resource with the interned path @a id in constant time.
+     *  See get(std::string_view).
+     */
+    template< typename Resource = MResource >
+    static Resource* get ( MResourceId id ) {
+        return cast<Resource> ( entry ( id ) );
+    }
+
+    /**
+     *  Limits the memory held by resources of @a type to @a bytes.
+     *  When the limit is exceeded the least recently used resources
+     *  without a MResourceHandle are evicted. There is no limit by default.
+     */
+    static void setBudget ( Type type, std::size_t bytes );
+
+    /**
+     *  @return  Memory limit for resources of @a type.
+     */
+    static std::size_t budget ( Type type );
+
+    /**
+     *  @return  Memory currently held by loaded resources of @a type.
+     */
+    static std::size_t usage ( Type type );
+
+    /**
+     *  @return  How often a requested file was already loaded and how often it had to be loaded.
+     */
+    static Statistics statistics ();
+
+    /**
+     *  Writes the registry and loader statistics to @a stream as JSON.
+     *  MLib::quit() writes them to the file named by the MLIB_RESOURCE_STATISTICS environment variable.
+     */
+    static void dumpStatistics ( std::ostream& stream );
+
+    /**
+     *  A file requested with loadAsync() finished loading.
+     *  Emitted from the worker thread.
+     *  @param  1 Path to the file.
+     *  @param  2 The resource or nullptr if loading failed.
+     */
+    static sigxx::signal<std::string,MResource*> loaded;
+
+    /**
+     *  A file was reloaded.
+     *  Emitted from the thread that reloaded it.
+     *  @param  1 Path to the file.
+     *  @param  2 The new resource.
+     */
+    static sigxx::signal<std::string,MResource*> reloaded;
+
+private:
+    template< typename Resource > friend class MResourceHandle;
+    static struct MResourceEntry* acquire ( const std::string& file, std::uint32_t& generation );
+    static struct MResourceEntry* acquire ( MResourceEntry* entry, std::uint32_t& generation );
+    static void release ( MResourceEntry* entry, std::uint32_t generation );
+    static MResourceEntry* find ( std::string_view file );
+    static MResourceEntry* entry ( MResourceId id );
+    static MResource* get ( MResourceEntry* entry );
+    static MResource* get ( MResourceEntry* entry, Type type );
+    template< typename Resource >
+    static Resource* cast ( MResourceEntry* entry ) {
+        if constexpr ( MResourceTyped<Resource>::value )
+            return static_cast<Resource*> ( get ( entry, Resource::resourceType ) );
+        else
+            return dynamic_cast<Resource*> ( get ( entry ) );
     }
 };
 
 inline MResource::~MResource() = default;
 
-template<>
-M_EXPORT MResource* MResource::get ( std::string file );
+template< typename Resource >
+inline Resource* MResourceId::get () const
+{
+    return MResource::get<Resource> ( *this );
+}
+
+/**
+ *  Reference counted handle to a resource.
+ *  A resource is never evicted while a handle to it exists.
+ */
+template< typename Resource = MResource >
+class MResourceHandle
+{
+public:
+    MResourceHandle () = default;
+    explicit MResourceHandle ( const std::string& file ) : m_entry{MResource::acquire ( file, m_generation )} {}
+    explicit MResourceHandle ( MResourceId id ) : m_entry{MResource::acquire ( MResource::entry ( id ), m_generation )} {}
+    MResourceHandle ( const MResourceHandle& other ) : m_entry{MResource::acquire ( other.m_entry, m_generation )} {}
+    MResourceHandle ( MResourceHandle&& other ) : m_generation{other.m_generation}, m_entry{std::exchange ( other.m_entry, nullptr )} {}
+    ~MResourceHandle () { MResource::release ( m_entry, m_generation ); }
+    MResourceHandle& operator= ( MResourceHandle other ) {
+        std::swap ( m_generation, other.m_generation );
+        std::swap ( m_entry, other.m_entry );
+        return *this;
+    }
+
+    /**
+     *  @return  The resource or nullptr if the file is not loaded.
+     */
+    Resource* get () const { return MResource::cast<Resource> ( m_entry ); }
+    Resource* operator-> () const { return get(); }
+    Resource& operator* () const { return *get(); }
+    explicit operator bool () const { return get(); }
+
+private:
+    // generation of the resource when the handle was acquired, acquire() sets it while m_entry is initialized
+    std::uint32_t m_generation = 0;
+    MResourceEntry* m_entry = nullptr;
+};
 
 #endif // MDATAFILE_H
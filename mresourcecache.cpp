@@ -0,0 +1,176 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mresourcecache_p.h"
+
+#include <maudiofile.h>
+#include <mdebug.h>
+#include <mimage.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+constexpr char magic[8] = { 'M', 'L', 'I', 'B', 'C', 'A', 'C', 'H' };
+constexpr std::size_t alignment = 0x1000;
+
+struct Header {
+    char magic[8];
+    std::uint32_t type;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t flags;
+    std::uint32_t freq;
+    std::uint32_t reserved;
+    std::uint64_t sourceSize;
+    std::uint64_t size;
+};
+
+static std::string cacheDirectory;
+static std::mutex mutex;
+
+static std::uint64_t hash ( const void* data, std::size_t size, std::uint64_t h = 0xcbf29ce484222325 )
+{
+    constexpr std::uint64_t prime = 0x100000001b3;
+    auto bytes = static_cast<const std::uint8_t*> ( data );
+    std::size_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+        std::uint64_t word;
+        std::memcpy ( &word, bytes + i, 8 );
+        h = ( h ^ word ) * prime;
+        h ^= h >> 29;
+    }
+    for ( ; i < size; i++ )
+        h = ( h ^ bytes[i] ) * prime;
+    return h;
+}
+
+static std::string path ( const MByteSource& source, MResourceLoader* loader )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if ( cacheDirectory.empty() )
+        return {};
+    auto name = loader->name();
+    auto version = loader->version();
+    auto h = hash ( name.data(), name.size() );
+    h = hash ( &version, sizeof version, h );
+    h = hash ( source.data(), source.size(), h );
+    char file[24];
+    std::snprintf ( file, sizeof file, "%016llx.mcache", static_cast<unsigned long long> ( h ) );
+    return cacheDirectory + '/' + file;
+}
+
+void MResourceCache::setDirectory ( const std::string& dir )
+{
+    std::error_code error;
+    if ( !dir.empty() )
+        std::filesystem::create_directories ( dir, error );
+    if ( error )
+        mDebug(ERROR) << dir << ": " << error.message();
+    std::lock_guard<std::mutex> lock{mutex};
+    cacheDirectory = error ? std::string{} : dir;
+}
+
+std::string MResourceCache::directory ()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return cacheDirectory;
+}
+
+MResource* MResourceCache::load ( const MByteSource& source, MResourceLoader* loader )
+{
+    auto file = path ( source, loader );
+    std::error_code error;
+    if ( file.empty() || !std::filesystem::exists ( file, error ) )
+        return nullptr;
+    auto cached = MByteSource::map ( file, true );
+    auto header = reinterpret_cast<const Header*> ( cached.data() );
+    if ( cached.size() < alignment || std::memcmp ( header->magic, magic, sizeof magic ) ||
+         header->type != loader->type() || header->sourceSize != source.size() ||
+         header->size > cached.size() - alignment )
+        return nullptr;
+    auto data = cached.slice ( alignment, header->size );
+    switch ( header->type ) {
+        case MResource::Image: {
+            auto image = new MImage{{header->width, header->height}, header->flags != 0, data};
+            if ( image->memoryUsage() == data.size() )
+                return image;
+            delete image;
+            return nullptr;
+        }
+        case MResource::Audio: {
+            auto audioFile = new MAudioFile;
+            audioFile->stereo = header->flags != 0;
+            audioFile->freq = header->freq;
+            audioFile->buffer->assign ( data.data(), data.data() + data.size() );
+            return audioFile;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+void MResourceCache::store ( const MByteSource& source, MResourceLoader* loader, const MResource* resource )
+{
+    Header header{};
+    const void* data = nullptr;
+    std::memcpy ( header.magic, magic, sizeof magic );
+    header.type = loader->type();
+    header.sourceSize = source.size();
+    if ( auto image = dynamic_cast<const MImage*> ( resource ) ) {
+        header.width = image->size().width();
+        header.height = image->size().height();
+        header.flags = image->hasAlpha();
+        header.size = image->memoryUsage();
+        data = image->data();
+    }
+    else if ( auto audioFile = dynamic_cast<const MAudioFile*> ( resource ) ) {
+        // compressed clips are already as small as they get and mapped ones are already samples
+        if ( audioFile->compressed.size() || audioFile->pcm )
+            return;
+        header.flags = audioFile->stereo;
+        header.freq = audioFile->freq;
+        header.size = audioFile->buffer->size();
+        data = audioFile->buffer->data();
+    }
+    else
+        return;
+    auto file = path ( source, loader );
+    if ( file.empty() )
+        return;
+    std::ostringstream tmp;
+    tmp << file << '.' << std::this_thread::get_id();
+    {
+        std::ofstream out{tmp.str(), std::ios::binary | std::ios::trunc};
+        out.write ( reinterpret_cast<const char*> ( &header ), sizeof header );
+        out.seekp ( alignment );
+        out.write ( static_cast<const char*> ( data ), header.size );
+        if ( !out ) {
+            mDebug(ERROR) << file << ": Write error";
+            out.close();
+            std::remove ( tmp.str().c_str() );
+            return;
+        }
+    }
+    std::rename ( tmp.str().c_str(), file.c_str() );
+}
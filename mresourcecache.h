@@ -0,0 +1,45 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MRESOURCECACHE_H
+#define MRESOURCECACHE_H
+
+#include <mglobal.h>
+#include <string>
+
+/**
+ *  Cache of decoded images and sounds on disk.
+ *  Entries are keyed by the contents of the file and the loader version,
+ *  cached pixels are mapped back without decoding the file again.
+ */
+namespace MResourceCache
+{
+    /**
+     *  Stores the cache in @a dir, an empty path disables the cache.
+     *  The cache is disabled by default.
+     */
+    M_EXPORT void setDirectory ( const std::string& dir );
+
+    /**
+     *  @return  Directory of the cache or an empty string if the cache is disabled.
+     */
+    M_EXPORT std::string directory ();
+}
+
+#endif // MRESOURCECACHE_H
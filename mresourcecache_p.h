@@ -0,0 +1,32 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MRESOURCECACHE_P_H
+#define MRESOURCECACHE_P_H
+
+#include <mresourcecache.h>
+#include <mresourceloader.h>
+
+namespace MResourceCache
+{
+    MResource* load ( const MByteSource& source, MResourceLoader* loader );
+    void store ( const MByteSource& source, MResourceLoader* loader, const MResource* resource );
+}
+
+#endif // MRESOURCECACHE_P_H
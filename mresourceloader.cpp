@@ -19,25 +19,74 @@
 
 #include "mresourceloader.h"
 
-#include <mdebug.h>
-#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+struct Signature {
+    std::string magic;
+    MResourceLoader* loader;
+};
+
+static std::unordered_map< std::uint16_t, std::list< Signature > > signatures;
+static std::list< MResourceLoader* > probes;
+static bool dirty = true;
+static std::mutex mutex;
+
+static std::uint16_t prefix ( const std::uint8_t* data )
+{
+    return data[0] << 8 | data[1];
+}
 
 MResourceLoader::MResourceLoader()
 {
+    std::lock_guard<std::mutex> lock{mutex};
     loaders().push_back ( this );
+    dirty = true;
 }
 
 MResourceLoader::~MResourceLoader()
 {
+    std::lock_guard<std::mutex> lock{mutex};
     loaders().remove ( this );
+    dirty = true;
+}
+
+std::list<std::string> MResourceLoader::magic()
+{
+    return {};
+}
+
+bool MResourceLoader::valid ( const MByteSource& source )
+{
+    (void)source;
+    return true;
+}
+
+MResourceLoader::Statistics MResourceLoader::statistics () const
+{
+    Statistics statistics;
+    statistics.count = m_count;
+    statistics.failures = m_failures;
+    statistics.cacheHits = m_cacheHits;
+    statistics.bytesRead = m_bytesRead;
+    statistics.bytesDecoded = m_bytesDecoded;
+    statistics.time = std::chrono::nanoseconds{m_time};
+    return statistics;
+}
+
+void MResourceLoader::record ( const Statistics& statistics )
+{
+    m_count += statistics.count;
+    m_failures += statistics.failures;
+    m_cacheHits += statistics.cacheHits;
+    m_bytesRead += statistics.bytesRead;
+    m_bytesDecoded += statistics.bytesDecoded;
+    m_time += statistics.time.count();
 }
 
-bool MResourceLoader::valid ( std::string file )
+std::uint32_t MResourceLoader::version()
 {
-    std::ifstream stream ( file );
-    if ( !stream.is_open() )
-        mDebug() << file << ": No such file or directory.";
-    return stream.good();
+    return 1;
 }
 
 MResourceLoader* MResourceLoader::get ( std::string name )
@@ -53,3 +102,32 @@ std::list< MResourceLoader* >& MResourceLoader::loaders()
     static std::list< MResourceLoader* > loaders;
     return loaders;
 }
+
+std::list< MResourceLoader* > MResourceLoader::find ( const MByteSource& source )
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if ( dirty ) {
+        signatures.clear();
+        probes.clear();
+        for ( auto loader: loaders() ) {
+            auto magic = loader->magic();
+            for ( auto&& m: magic )
+                if ( m.size() >= 2 )
+                    signatures[prefix ( reinterpret_cast<const std::uint8_t*> ( m.data() ) )].push_back ( { m, loader } );
+            if ( magic.empty() )
+                probes.push_back ( loader );
+        }
+        dirty = false;
+    }
+    std::list< MResourceLoader* > found;
+    if ( source.size() >= 2 ) {
+        auto i = signatures.find ( prefix ( source.data() ) );
+        if ( i != signatures.end() )
+            for ( auto&& signature: i->second )
+                if ( signature.magic.size() <= source.size() &&
+                     !signature.magic.compare ( 0, std::string::npos, reinterpret_cast<const char*> ( source.data() ), signature.magic.size() ) )
+                    found.push_back ( signature.loader );
+    }
+    found.insert ( found.end(), probes.begin(), probes.end() );
+    return found;
+}
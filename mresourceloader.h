@@ -21,20 +21,66 @@
 #define MDATALOADER_H
 
 #include "mglobal.h"
+#include <mbytesource.h>
 #include <mresource.h>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <string>
 
 struct M_EXPORT MResourceLoader
 {
+    struct Statistics {
+        std::uint64_t count = 0;
+        std::uint64_t failures = 0;
+        std::uint64_t cacheHits = 0;
+        std::uint64_t bytesRead = 0;
+        std::uint64_t bytesDecoded = 0;
+        std::chrono::nanoseconds time{};
+    };
+
     MResourceLoader();
     virtual ~MResourceLoader();
-    virtual bool valid ( std::string file );
-    virtual MResource* M_WARN_UNUSED_RESULT load ( std::string file ) = 0;
+
+    /**
+     *  @return  Signatures at the start of the files this loader can load.
+     *  Loaders without signatures are tried on every file after the ones whose signature matched.
+     */
+    virtual std::list<std::string> magic();
+    virtual bool valid ( const MByteSource& source );
+    virtual MResource* M_WARN_UNUSED_RESULT load ( const MByteSource& source ) = 0;
     virtual std::string name() = 0;
     virtual MResource::Type type() = 0;
+
+    /**
+     *  @return  Version of the decoded output, cached resources of other versions are decoded again.
+     */
+    virtual std::uint32_t version();
     static MResourceLoader* get ( std::string name );
     static std::list< MResourceLoader* >& loaders();
+
+    /**
+     *  @return  Loaders that may be able to load @a source, in the order they should be tried.
+     */
+    static std::list< MResourceLoader* > find ( const MByteSource& source );
+
+    /**
+     *  @return  Files handled by this loader, including the failed ones and the ones found in the cache.
+     */
+    Statistics statistics () const;
+
+    /**
+     *  Adds @a statistics to the statistics of this loader.
+     */
+    void record ( const Statistics& statistics );
+
+private:
+    std::atomic<std::uint64_t> m_count{};
+    std::atomic<std::uint64_t> m_failures{};
+    std::atomic<std::uint64_t> m_cacheHits{};
+    std::atomic<std::uint64_t> m_bytesRead{};
+    std::atomic<std::uint64_t> m_bytesDecoded{};
+    std::atomic<std::int64_t> m_time{};
 };
 
 #endif // MDATALOADER_H
@@ -0,0 +1,107 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mresourcepack.h"
+#include "mresourcepack_p.h"
+
+#include <mdebug.h>
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+
+struct Pack {
+    std::string file;
+    std::string root;
+    MByteSource source;
+    const MResourcePackEntry* entries;
+    std::uint32_t count;
+};
+
+static std::list<Pack> packs;
+static std::shared_mutex mutex;
+
+bool MResourcePack::mount ( const std::string& file, const std::string& root )
+{
+    auto source = MByteSource::map ( file );
+    if ( !source )
+        return false;
+    auto header = reinterpret_cast<const MResourcePackHeader*> ( source.data() );
+    if ( source.size() < sizeof *header ||
+         std::memcmp ( header->magic, M_RESOURCE_PACK_MAGIC, sizeof header->magic ) ||
+         leLoad ( header->version ) != M_RESOURCE_PACK_VERSION ||
+         ( source.size() - sizeof *header ) / sizeof ( MResourcePackEntry ) < leLoad ( header->count ) ) {
+        mDebug(ERROR) << file << ": Not an mlib-pack archive.";
+        return false;
+    }
+    auto entries = reinterpret_cast<const MResourcePackEntry*> ( header + 1 );
+    std::uint32_t count = leLoad ( header->count );
+    for ( std::uint32_t i = 0; i < count; i++ ) {
+        auto name = leLoad ( entries[i].name );
+        auto offset = leLoad ( entries[i].offset );
+        if ( name > source.size() || leLoad ( entries[i].nameSize ) > source.size() - name ||
+             offset > source.size() || leLoad ( entries[i].size ) > source.size() - offset ) {
+            mDebug(ERROR) << file << ": Corrupted mlib-pack archive.";
+            return false;
+        }
+    }
+    std::string dir = root;
+    if ( !dir.empty() && dir.back() != '/' )
+        dir += '/';
+    std::unique_lock<std::shared_mutex> lock{mutex};
+    packs.push_front ( { file, dir, source, entries, count } );
+    return true;
+}
+
+void MResourcePack::unmount ( const std::string& file )
+{
+    std::unique_lock<std::shared_mutex> lock{mutex};
+    packs.remove_if ( [&file] ( const Pack& pack ) { return pack.file == file; } );
+}
+
+MByteSource MResourcePack::find ( const std::string& file )
+{
+    std::shared_lock<std::shared_mutex> lock{mutex};
+    for ( auto&& pack: packs ) {
+        if ( file.compare ( 0, pack.root.size(), pack.root ) )
+            continue;
+        auto name = file.c_str() + pack.root.size();
+        auto nameSize = file.size() - pack.root.size();
+        std::uint32_t first = 0;
+        std::uint32_t last = pack.count;
+        while ( first < last ) {
+            auto middle = first + ( last - first ) / 2;
+            auto& entry = pack.entries[middle];
+            auto entryName = reinterpret_cast<const char*> ( pack.source.data() + leLoad ( entry.name ) );
+            auto entrySize = leLoad ( entry.nameSize );
+            int cmp = std::memcmp ( entryName, name, std::min<std::uint64_t> ( entrySize, nameSize ) );
+            if ( !cmp )
+                cmp = entrySize < nameSize ? -1 : entrySize > nameSize;
+            if ( !cmp )
+                return pack.source.slice ( leLoad ( entry.offset ), leLoad ( entry.size ) );
+            if ( cmp < 0 )
+                first = middle + 1;
+            else
+                last = middle;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MRESOURCEPACK_H
+#define MRESOURCEPACK_H
+
+#include <mbytesource.h>
+#include <string>
+
+/**
+ *  Archives created by the mlib-pack tool.
+ *  Files of mounted archives are served from a single mapping of the archive.
+ */
+namespace MResourcePack
+{
+    /**
+     *  Maps the archive @a file and makes its contents available under the directory @a root.
+     *  @return  False if @a file is not a valid archive.
+     */
+    M_EXPORT bool mount ( const std::string& file, const std::string& root );
+
+    /**
+     *  Unmounts the archive @a file.
+     *  Sources returned by find() stay valid.
+     */
+    M_EXPORT void unmount ( const std::string& file );
+
+    /**
+     *  @return  Contents of @a file or an empty source if no mounted archive contains it.
+     */
+    M_EXPORT MByteSource find ( const std::string& file );
+}
+
+#endif // MRESOURCEPACK_H
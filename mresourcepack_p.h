@@ -0,0 +1,71 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MRESOURCEPACK_P_H
+#define MRESOURCEPACK_P_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ *  Layout of an mlib-pack archive, all integers are little endian:
+ *
+ *  MResourcePackHeader
+ *  MResourcePackEntry[count], sorted by name
+ *  names, not terminated
+ *  file data, every file starts on a page boundary
+ *
+ *  Integers are kept as bytes and converted with leLoad() and leStore(),
+ *  so the layout doesn't depend on the byte order or alignment of the host.
+ */
+
+constexpr char M_RESOURCE_PACK_MAGIC[8] = { 'M', 'L', 'I', 'B', 'P', 'A', 'C', 'K' };
+constexpr std::uint32_t M_RESOURCE_PACK_VERSION = 1;
+constexpr std::uint64_t M_RESOURCE_PACK_ALIGNMENT = 0x1000;
+
+struct MResourcePackHeader {
+    char magic[8];
+    std::uint8_t version[4];
+    std::uint8_t count[4];
+};
+
+struct MResourcePackEntry {
+    std::uint8_t name[8];
+    std::uint8_t nameSize[8];
+    std::uint8_t offset[8];
+    std::uint8_t size[8];
+};
+
+template< std::size_t size >
+inline std::uint64_t leLoad ( const std::uint8_t ( &data )[size] )
+{
+    std::uint64_t value = 0;
+    for ( std::size_t i = size; i--; )
+        value = value << 8 | data[i];
+    return value;
+}
+
+template< std::size_t size >
+inline void leStore ( std::uint8_t ( &data )[size], std::uint64_t value )
+{
+    for ( std::size_t i = 0; i < size; i++, value >>= 8 )
+        data[i] = value;
+}
+
+#endif // MRESOURCEPACK_P_H
@@ -0,0 +1,261 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mresourcepreload.h"
+
+#include <mresource.h>
+#include <mtaskbatch_p.h>
+#include <mthreadpool.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <algorithm>
+#include <filesystem>
+
+/*
+ *  Matches @a name against @a pattern with the *, ? and [...] wildcards of glob().
+ */
+static bool match ( const char* pattern, const char* name )
+{
+    for ( ; *pattern; pattern++, name++ ) {
+        switch ( *pattern ) {
+        case '*':
+            for ( ; ; name++ ) {
+                if ( match ( pattern + 1, name ) )
+                    return true;
+                if ( !*name )
+                    return false;
+            }
+        case '?':
+            if ( !*name )
+                return false;
+            break;
+        case '[': {
+            auto end = pattern + 1;
+            bool negate = *end == '!';
+            end += negate;
+            if ( *end == ']' )
+                end++;
+            while ( *end && *end != ']' )
+                end++;
+            if ( !*end ) {
+                // unterminated, matches itself
+                if ( *name != '[' )
+                    return false;
+                break;
+            }
+            if ( !*name )
+                return false;
+            bool found = false;
+            for ( auto c = pattern + 1 + negate; c < end; c++ ) {
+                if ( c[1] == '-' && c + 2 < end ) {
+                    found |= *name >= c[0] && *name <= c[2];
+                    c += 2;
+                }
+                else
+                    found |= *c == *name;
+            }
+            if ( found == negate )
+                return false;
+            pattern = end;
+            break;
+        }
+        default:
+            if ( *pattern != *name )
+                return false;
+        }
+    }
+    return !*name;
+}
+
+/*
+ *  Expands @a pattern one path component at a time, like glob() with GLOB_NOCHECK.
+ */
+static std::vector<std::string> expand ( const std::string& pattern )
+{
+    std::vector<std::filesystem::path> paths{{}};
+    bool wildcards = false;
+    for ( auto& part: std::filesystem::path{pattern} ) {
+        auto name = part.string();
+        if ( name.find_first_of ( "*?[" ) == std::string::npos ) {
+            for ( auto& path: paths )
+                path /= part;
+            continue;
+        }
+        wildcards = true;
+        std::vector<std::filesystem::path> next;
+        for ( auto& path: paths ) {
+            std::error_code error;
+            for ( auto& child: std::filesystem::directory_iterator{path.empty() ? "." : path, error} ) {
+                auto file = child.path().filename().string();
+                if ( ( file[0] != '.' || name[0] == '.' ) && match ( name.c_str(), file.c_str() ) )
+                    next.push_back ( path / file );
+            }
+        }
+        paths = std::move ( next );
+    }
+    std::vector<std::string> files;
+    for ( auto& path: paths ) {
+        std::error_code error;
+        if ( !wildcards || std::filesystem::exists ( path, error ) )
+            files.push_back ( path.string() );
+    }
+    std::sort ( files.begin(), files.end() );
+    if ( files.empty() )
+        files.push_back ( pattern );
+    return files;
+}
+#else
+#include <glob.h>
+
+static std::vector<std::string> expand ( const std::string& pattern )
+{
+    std::vector<std::string> files;
+    glob_t matches;
+    if ( glob ( pattern.c_str(), GLOB_NOCHECK, nullptr, &matches ) == 0 )
+        files.assign ( matches.gl_pathv, matches.gl_pathv + matches.gl_pathc );
+    globfree ( &matches );
+    return files;
+}
+#endif
+
+struct MResourcePreloadPrivate {
+    using Tiers = std::map< int, std::vector<std::string>, std::greater<int> >;
+
+    void start ();
+    void load ( const std::string& file );
+
+    MResourcePreload* q;
+    Tiers tiers;
+    Tiers::iterator tier;
+    std::mutex mutex;
+    std::size_t total = 0;
+    std::size_t loaded = 0;
+    std::size_t failed = 0;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> started{false};
+    MTaskBatch batch{false};
+};
+
+void MResourcePreloadPrivate::start ()
+{
+    while ( tier != tiers.end() && tier->second.empty() )
+        ++tier;
+    if ( cancelled || tier == tiers.end() ) {
+        q->finished ( cancelled );
+        batch.complete();
+        return;
+    }
+    batch.add ( tier->second.size() );
+    int priority = tier->first;
+    for ( auto&& file: tier->second )
+        MThreadPool::global().push ( std::bind ( &MResourcePreloadPrivate::load, this, file ), priority );
+}
+
+void MResourcePreloadPrivate::load ( const std::string& file )
+{
+    bool ok = !cancelled && MResource::load ( file );
+    std::size_t processed;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if ( ok )
+            loaded++;
+        else if ( !cancelled )
+            failed++;
+        processed = loaded + failed;
+    }
+    if ( !cancelled )
+        q->progress ( processed, total );
+    if ( !batch.finish() )
+        return;
+    ++tier;
+    start();
+}
+
+MResourcePreload* MResource::preload ( const std::list<MResourcePreload::Entry>& manifest )
+{
+    return new MResourcePreload{manifest};
+}
+
+MResourcePreload::MResourcePreload ( const std::list<Entry>& manifest )
+    : d{new MResourcePreloadPrivate}
+{
+    d->q = this;
+    for ( auto&& entry: manifest ) {
+        auto matches = expand ( entry.pattern );
+        auto& files = d->tiers[entry.priority];
+        files.insert ( files.end(), matches.begin(), matches.end() );
+        d->total += matches.size();
+    }
+    d->tier = d->tiers.begin();
+}
+
+MResourcePreload::~MResourcePreload ()
+{
+    cancel();
+    wait();
+    delete d;
+}
+
+void MResourcePreload::start ()
+{
+    if ( d->started.exchange ( true ) )
+        return;
+    d->start();
+}
+
+void MResourcePreload::cancel ()
+{
+    d->cancelled = true;
+}
+
+void MResourcePreload::wait ()
+{
+    if ( !d->started )
+        return;
+    d->batch.wait();
+}
+
+bool MResourcePreload::done ()
+{
+    return d->batch.done();
+}
+
+std::size_t MResourcePreload::total ()
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return d->total;
+}
+
+std::size_t MResourcePreload::loaded ()
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return d->loaded;
+}
+
+std::size_t MResourcePreload::failed ()
+{
+    std::lock_guard<std::mutex> lock{d->mutex};
+    return d->failed;
+}
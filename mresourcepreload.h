@@ -0,0 +1,112 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MRESOURCEPRELOAD_H
+#define MRESOURCEPRELOAD_H
+
+#include <mglobal.h>
+#include <list>
+#include <sigxx.hh>
+#include <string>
+
+/**
+ *  Loads a set of files on the global thread pool.
+ *  Files with the same priority are loaded concurrently, files with a lower
+ *  priority are only started once all files with a higher priority are loaded.
+ */
+class M_EXPORT MResourcePreload
+{
+public:
+    struct Entry {
+        /**
+         *  Path to a file or a glob pattern.
+         */
+        std::string pattern;
+        int priority = 0;
+    };
+
+    /**
+     *  Expands the patterns in @a manifest, loading starts with start().
+     */
+    explicit MResourcePreload ( const std::list<Entry>& manifest );
+    MResourcePreload ( const MResourcePreload& ) = delete;
+
+    /**
+     *  Cancels loading and waits for the files being loaded.
+     */
+    ~MResourcePreload ();
+    MResourcePreload& operator= ( const MResourcePreload& ) = delete;
+
+    /**
+     *  Starts loading, connect to the signals before calling it.
+     *  An empty manifest emits @c finished before it returns.
+     */
+    void start ();
+
+    /**
+     *  Stops loading, files that are already being loaded are finished.
+     */
+    void cancel ();
+
+    /**
+     *  Blocks until loading is finished or cancelled.
+     *  Returns immediately if loading wasn't started.
+     */
+    void wait ();
+
+    /**
+     *  @return  True if loading is finished or cancelled.
+     */
+    bool done ();
+
+    /**
+     *  @return  Number of files in the manifest.
+     */
+    std::size_t total ();
+
+    /**
+     *  @return  Number of files loaded so far.
+     */
+    std::size_t loaded ();
+
+    /**
+     *  @return  Number of files that failed to load so far.
+     */
+    std::size_t failed ();
+
+    /**
+     *  A file finished loading.
+     *  Emitted from a worker thread.
+     *  @param  1 Number of files processed so far.
+     *  @param  2 Number of files in the manifest.
+     */
+    sigxx::signal<std::size_t,std::size_t> progress{this};
+
+    /**
+     *  All files were processed.
+     *  Emitted from a worker thread.
+     *  @param  1 True if loading was cancelled.
+     */
+    sigxx::signal<bool> finished{this};
+
+private:
+    struct MResourcePreloadPrivate* const d;
+};
+
+#endif // MRESOURCEPRELOAD_H
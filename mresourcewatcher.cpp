@@ -0,0 +1,128 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mresourcewatcher_p.h"
+
+#include <mdebug.h>
+#include <mresource.h>
+#include <mthreadpool.h>
+
+#ifdef __linux__
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static int inotifyFd = -1;
+static int wakeFd = -1;
+static std::thread thread;
+static std::mutex mutex;
+static std::unordered_map< int, std::string > directories;
+static std::unordered_map< std::string, int > watches;
+static std::unordered_set< std::string > files;
+
+static void run ()
+{
+    alignas(inotify_event) char buffer[0x1000];
+    pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+    for (;;) {
+        if ( poll ( fds, 2, -1 ) < 0 )
+            continue;
+        if ( fds[1].revents )
+            return;
+        auto size = read ( inotifyFd, buffer, sizeof buffer );
+        for ( decltype(size) i = 0; i < size; ) {
+            auto event = reinterpret_cast<inotify_event*> ( buffer + i );
+            i += sizeof ( inotify_event ) + event->len;
+            if ( !event->len )
+                continue;
+            std::unique_lock<std::mutex> lock{mutex};
+            auto file = directories[event->wd] + event->name;
+            if ( !files.count ( file ) )
+                continue;
+            lock.unlock();
+            MThreadPool::global().push ( [file] {
+                if ( !MResource::reload ( file ) )
+                    mDebug(ERROR) << "Failed to reload " << file;
+            } );
+        }
+    }
+}
+
+bool MResourceWatcher::start ()
+{
+    inotifyFd = inotify_init1 ( IN_CLOEXEC | IN_NONBLOCK );
+    if ( inotifyFd < 0 )
+        return false;
+    wakeFd = eventfd ( 0, EFD_CLOEXEC );
+    if ( wakeFd < 0 ) {
+        close ( inotifyFd );
+        return false;
+    }
+    thread = std::thread{run};
+    return true;
+}
+
+void MResourceWatcher::stop ()
+{
+    std::uint64_t one = 1;
+    if ( write ( wakeFd, &one, sizeof one ) < 0 )
+        mDebug(ERROR) << "Failed to stop watching resources";
+    thread.join();
+    close ( wakeFd );
+    close ( inotifyFd );
+    std::lock_guard<std::mutex> lock{mutex};
+    directories.clear();
+    watches.clear();
+    files.clear();
+}
+
+void MResourceWatcher::add ( const std::string& file )
+{
+    auto slash = file.rfind ( '/' );
+    auto directory = slash == std::string::npos ? std::string{} : file.substr ( 0, slash + 1 );
+    std::lock_guard<std::mutex> lock{mutex};
+    if ( !files.insert ( file ).second || watches.count ( directory ) )
+        return;
+    int wd = inotify_add_watch ( inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO );
+    if ( wd < 0 )
+        return;
+    watches[directory] = wd;
+    directories[wd] = directory;
+}
+#else
+bool MResourceWatcher::start ()
+{
+    return false;
+}
+
+void MResourceWatcher::stop ()
+{
+}
+
+void MResourceWatcher::add ( const std::string& file )
+{
+    (void)file;
+}
+#endif
@@ -0,0 +1,80 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTASKBATCH_P_H
+#define MTASKBATCH_P_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/**
+ *  Tracks a batch of tasks run on the thread pool by an object that waits for them when it's deleted.
+ *  A task calls finish() only after its last access to the object, signals included,
+ *  so the object can't be deleted while a task still uses it.
+ */
+class MTaskBatch
+{
+public:
+    explicit MTaskBatch ( bool done ) : m_done{done} {}
+
+    /**
+     *  Expects @a count more tasks to finish, call it before they are pushed.
+     */
+    void add ( std::size_t count ) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_pending += count;
+        m_done = false;
+    }
+
+    /**
+     *  @return  True for the task that finished last, it has to call complete() eventually.
+     */
+    bool finish () {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return !--m_pending;
+    }
+
+    /**
+     *  Marks the batch done and wakes wait().
+     */
+    void complete () {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_done = true;
+        m_condition.notify_all();
+    }
+
+    void wait () {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_condition.wait ( lock, [this] { return m_done; } );
+    }
+
+    bool done () {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_done;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::size_t m_pending = 0;
+    bool m_done;
+};
+
+#endif // MTASKBATCH_P_H
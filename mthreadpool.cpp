@@ -0,0 +1,103 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mthreadpool.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+struct MThreadPoolPrivate {
+    struct Task {
+        int priority;
+        std::uint64_t serial;
+        std::function<void()> function;
+        bool operator< ( const Task& other ) const {
+            if ( priority != other.priority )
+                return priority < other.priority;
+            return serial > other.serial;
+        }
+    };
+
+    void run ();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::priority_queue<Task> tasks;
+    std::vector<std::thread> threads;
+    std::uint64_t serial = 0;
+    bool quit = false;
+};
+
+void MThreadPoolPrivate::run ()
+{
+    for (;;) {
+        std::unique_lock<std::mutex> lock{mutex};
+        condition.wait ( lock, [this] { return quit || !tasks.empty(); } );
+        if ( tasks.empty() )
+            return;
+        auto function = std::move ( const_cast<Task&> ( tasks.top() ).function );
+        tasks.pop();
+        lock.unlock();
+        function();
+    }
+}
+
+MThreadPool::MThreadPool ( unsigned int threads )
+    : d{new MThreadPoolPrivate}
+{
+    if ( !threads )
+        threads = 1;
+    for ( unsigned int i = 0; i < threads; i++ )
+        d->threads.emplace_back ( &MThreadPoolPrivate::run, d );
+}
+
+MThreadPool::~MThreadPool ()
+{
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+        d->quit = true;
+    }
+    d->condition.notify_all();
+    for ( auto& thread: d->threads )
+        thread.join();
+    delete d;
+}
+
+void MThreadPool::push ( std::function<void()> task, int priority )
+{
+    {
+        std::lock_guard<std::mutex> lock{d->mutex};
+        d->tasks.push ( { priority, d->serial++, std::move ( task ) } );
+    }
+    d->condition.notify_one();
+}
+
+unsigned int MThreadPool::size () const
+{
+    return d->threads.size();
+}
+
+MThreadPool& MThreadPool::global ()
+{
+    static MThreadPool pool;
+    return pool;
+}
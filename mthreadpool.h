@@ -0,0 +1,63 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTHREADPOOL_H
+#define MTHREADPOOL_H
+
+#include <mglobal.h>
+#include <functional>
+#include <thread>
+
+class M_EXPORT MThreadPool
+{
+public:
+    /**
+     *  Starts @a threads worker threads.
+     */
+    explicit MThreadPool ( unsigned int threads = std::thread::hardware_concurrency() );
+    MThreadPool ( const MThreadPool& ) = delete;
+
+    /**
+     *  Runs the remaining tasks and joins the worker threads.
+     */
+    ~MThreadPool ();
+    MThreadPool& operator= ( const MThreadPool& ) = delete;
+
+    /**
+     *  Queues @a task.
+     *  Tasks with a higher @a priority are started first,
+     *  tasks with the same priority are started in the order they were pushed.
+     */
+    void push ( std::function<void()> task, int priority = 0 );
+
+    /**
+     *  @return  The number of worker threads.
+     */
+    unsigned int size () const;
+
+    /**
+     *  @return  The pool shared by the whole library.
+     */
+    static MThreadPool& global ();
+
+private:
+    struct MThreadPoolPrivate* const d;
+};
+
+#endif // MTHREADPOOL_H
@@ -22,6 +22,7 @@
 #include <mresourceloader.h>
 #include <mtexture.h>
 
+#include <mutex>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
@@ -39,7 +40,9 @@ static class MType : public MResourceLoader
         virtual uint16_t getSize() override;
         virtual bool setSize ( uint16_t size, uint16_t res = 0 ) override;
         virtual MTexture* render ( wstring text ) override;
+        virtual size_t memoryUsage() const override;
         FT_Face face;
+        MByteSource source;
     };
 
 public:
@@ -48,10 +51,12 @@ public:
     virtual MResource::Type type() override { return MResource::Font; }
 
 private:
-    virtual MResource* load ( string file );
+    virtual list<string> magic() override;
+    virtual MResource* load ( const MByteSource& source ) override;
     virtual string name();
 
     FT_Library library;
+    mutex libraryMutex;
 } freetype;
 
 MType::MType()
@@ -64,10 +69,16 @@ MType::~MType()
     FT_Done_FreeType ( library );
 }
 
-MResource* MType::load ( string file )
+list<string> MType::magic()
+{
+    return { "\0\1\0\0"s, "true", "OTTO", "ttcf", "wOFF" };
+}
+
+MResource* MType::load ( const MByteSource& source )
 {
     FT_Face face;
-    if ( FT_New_Face ( library, file.c_str(), 0, &face ) )
+    lock_guard<mutex> lock{libraryMutex};
+    if ( FT_New_Memory_Face ( library, source.data(), source.size(), 0, &face ) )
         return nullptr;
     if ( FT_Set_Char_Size ( face, 0, 1280, 0, 0 ) ) {
         FT_Done_Face ( face );
@@ -75,6 +86,7 @@ MResource* MType::load ( string file )
     }
     Font* font = new Font;
     font->face = face;
+    font->source = source;
     font->setSize ( 20 );
     return font;
 }
@@ -86,9 +98,15 @@ string MType::name()
 
 MType::Font::~Font()
 {
+    lock_guard<mutex> lock{freetype.libraryMutex};
     FT_Done_Face ( face );
 }
 
+size_t MType::Font::memoryUsage() const
+{
+    return source.size();
+}
+
 uint16_t MType::Font::getSize()
 {
     return face->size->metrics.x_ppem;
@@ -23,6 +23,9 @@
 #include <mdebug.h>
 
 #include <vorbis/vorbisfile.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <istream>
 
 static struct VorbisInterface : public MAudioStreamInterface
@@ -30,12 +33,63 @@ static struct VorbisInterface : public MAudioStreamInterface
     virtual bool valid ( std::istream* stream ) const;
     virtual void init ( MAudioStream* audioStream ) const;
     virtual void fini ( MAudioStream* audioStream ) const;
-    virtual void read ( MAudioStream* audioStream ) const;
+    virtual std::size_t read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const;
+    virtual std::size_t readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const override;
     virtual void seek ( MAudioStream* audioStream, double seconds ) const;
     virtual double tell ( MAudioStream* audioStream ) const;
+    virtual double length ( MAudioStream* audioStream ) const override;
+    virtual std::int64_t frames ( MAudioStream* audioStream ) const override;
     virtual std::list<std::string> getTag ( MAudioStream* audioStream, MAudioTag tag ) const override;
 } iface;
 
+/*
+ *  Reads a byte source directly, ov_clear() deletes it through close_func.
+ */
+struct MemoryFile {
+    MByteSource source;
+    std::size_t position;
+};
+
+static const ov_callbacks memoryCallbacks{
+    [] (void *ptr, std::size_t size, std::size_t nmemb, void *datasource) -> std::size_t {
+        auto file = static_cast<MemoryFile*> ( datasource );
+        if ( !size )
+            return 0;
+        auto count = std::min ( nmemb, ( file->source.size() - file->position ) / size );
+        std::memcpy ( ptr, file->source.data() + file->position, count * size );
+        file->position += count * size;
+        return count;
+    },
+    [] (void *datasource, ogg_int64_t offset, int whence) -> int {
+        auto file = static_cast<MemoryFile*> ( datasource );
+        ogg_int64_t base;
+        switch ( whence ) {
+            case SEEK_SET:
+                base = 0;
+                break;
+            case SEEK_CUR:
+                base = file->position;
+                break;
+            case SEEK_END:
+                base = file->source.size();
+                break;
+            default:
+                return -1;
+        }
+        if ( base + offset < 0 || base + offset > ogg_int64_t ( file->source.size() ) )
+            return -1;
+        file->position = base + offset;
+        return 0;
+    },
+    [] (void *datasource) -> int {
+        delete static_cast<MemoryFile*> ( datasource );
+        return 0;
+    },
+    [] (void *datasource) -> long {
+        return static_cast<MemoryFile*> ( datasource )->position;
+    },
+};
+
 bool VorbisInterface::valid ( std::istream* stream ) const
 {
     stream->seekg(0);
@@ -86,8 +140,19 @@ void VorbisInterface::init ( MAudioStream* audioStream ) const
             return stream ( audioStream ) ->tellg();
         },
     };
-    stream ( audioStream ) ->seekg(0);
-    if ( ov_open_callbacks ( audioStream, vorbisFile, nullptr, 0, callbacks ) < 0 ) {
+    int error;
+    if ( auto& data = source ( audioStream ) ) {
+        auto memoryFile = new MemoryFile{data, 0};
+        error = ov_open_callbacks ( memoryFile, vorbisFile, nullptr, 0, memoryCallbacks );
+        // a failed open doesn't close the data source
+        if ( error < 0 )
+            delete memoryFile;
+    }
+    else {
+        stream ( audioStream ) ->seekg(0);
+        error = ov_open_callbacks ( audioStream, vorbisFile, nullptr, 0, callbacks );
+    }
+    if ( error < 0 ) {
         delete vorbisFile;
         return;
     }
@@ -106,7 +171,8 @@ void VorbisInterface::fini ( MAudioStream* audioStream ) const
 
 void VorbisInterface::seek ( MAudioStream* audioStream, double seconds ) const
 {
-    ov_time_seek ( &userdata<OggVorbis_File> ( audioStream ), seconds );
+    // ov_time_seek truncates to the sample before, round to the nearest one
+    ov_pcm_seek ( &userdata<OggVorbis_File> ( audioStream ), std::llround ( seconds * audioStream->freq() ) );
 }
 
 double VorbisInterface::tell ( MAudioStream* audioStream ) const
@@ -114,25 +180,71 @@ double VorbisInterface::tell ( MAudioStream* audioStream ) const
     return ov_time_tell ( &userdata<OggVorbis_File> ( audioStream ) );
 }
 
-void VorbisInterface::read ( MAudioStream* audioStream ) const
+double VorbisInterface::length ( MAudioStream* audioStream ) const
 {
-    audioStream->buffer_size = 0;
+    auto length = ov_time_total ( &userdata<OggVorbis_File> ( audioStream ), -1 );
+    return length < 0 ? 0 : length;
+}
+
+std::int64_t VorbisInterface::frames ( MAudioStream* audioStream ) const
+{
+    auto frames = ov_pcm_total ( &userdata<OggVorbis_File> ( audioStream ), -1 );
+    return frames < 0 ? 0 : frames;
+}
+
+std::size_t VorbisInterface::read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const
+{
+    std::size_t filled = 0;
     long read;
     do {
-        read = ov_read ( &userdata<OggVorbis_File> ( audioStream ), audioStream->buffer + audioStream->buffer_size,
-                         sizeof(audioStream->buffer) - audioStream->buffer_size, 0, 2, 1, nullptr );
+        read = ov_read ( &userdata<OggVorbis_File> ( audioStream ), buffer + filled, size - filled, 0, 2, 1, nullptr );
         if ( read <= 0 )
             switch ( read ) {
                 case 0:
                     setEOF ( audioStream );
-                    return;
+                    return filled;
                 case OV_HOLE:
                     mDebug(ERROR) << "OV_HOLE";
+                    read = 0;
                     break;
+                default:
+                    mDebug(ERROR) << "ov_read failed";
+                    setEOF ( audioStream );
+                    return filled;
             }
         else
-            audioStream->buffer_size += read;
-    } while ( audioStream->buffer_size + read < sizeof(audioStream->buffer) );
+            filled += read;
+    } while ( filled + read < size );
+    return filled;
+}
+
+std::size_t VorbisInterface::readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const
+{
+    auto vorbisFile = &userdata<OggVorbis_File> ( audioStream );
+    // the decoder keeps a plane per channel, only the first one or two are interleaved
+    std::size_t channels = audioStream->stereo() ? 2 : 1;
+    std::size_t filled = 0;
+    while ( filled + channels <= count ) {
+        float** pcm;
+        long read = ov_read_float ( vorbisFile, &pcm, ( count - filled ) / channels, nullptr );
+        if ( read <= 0 )
+            switch ( read ) {
+                case 0:
+                    setEOF ( audioStream );
+                    return filled;
+                case OV_HOLE:
+                    mDebug(ERROR) << "OV_HOLE";
+                    continue;
+                default:
+                    mDebug(ERROR) << "ov_read_float failed";
+                    setEOF ( audioStream );
+                    return filled;
+            }
+        for ( long i = 0; i < read; i++ )
+            for ( std::size_t c = 0; c < channels; c++ )
+                buffer[filled++] = pcm[c][i];
+    }
+    return filled;
 }
 
 std::list<std::string> VorbisInterface::getTag ( MAudioStream* audioStream, MAudioTag tag ) const
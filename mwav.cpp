@@ -0,0 +1,290 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <maudiostream.h>
+#include <mdebug.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum {
+    WAVE_FORMAT_PCM = 1,
+    WAVE_FORMAT_IEEE_FLOAT = 3,
+    WAVE_FORMAT_EXTENSIBLE = 0xfffe,
+};
+
+struct WavFile {
+    MByteSource samples;
+    int format;
+    int channels;
+    int bits;
+    std::size_t frame;
+    std::size_t frames;
+    std::size_t position = 0;
+    std::vector< std::pair<std::string,std::string> > info;
+};
+
+static struct WavInterface : public MAudioStreamInterface
+{
+    virtual bool valid ( std::istream* stream ) const;
+    virtual void init ( MAudioStream* audioStream ) const;
+    virtual void fini ( MAudioStream* audioStream ) const;
+    virtual std::size_t read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const;
+    virtual std::size_t readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const override;
+    virtual const char* map ( MAudioStream* audioStream, std::size_t& size ) const override;
+    virtual void seek ( MAudioStream* audioStream, double seconds ) const;
+    virtual double tell ( MAudioStream* audioStream ) const;
+    virtual double length ( MAudioStream* audioStream ) const override;
+    virtual std::int64_t frames ( MAudioStream* audioStream ) const override;
+    virtual std::list<std::string> getTag ( MAudioStream* audioStream, MAudioTag tag ) const override;
+} iface;
+
+static std::uint32_t le16 ( const std::uint8_t* data )
+{
+    return data[0] | data[1] << 8;
+}
+
+static std::uint32_t le32 ( const std::uint8_t* data )
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | std::uint32_t ( data[3] ) << 24;
+}
+
+/*
+ *  @return  True if the samples can be used as they are stored.
+ */
+static bool native ( const WavFile& wav )
+{
+    return wav.format == WAVE_FORMAT_PCM && wav.bits == 16 && wav.channels <= 2 &&
+           __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+}
+
+/*
+ *  Converts a sample to float, WAV samples are little endian and 8-bit ones are unsigned.
+ */
+static float sample ( const WavFile& wav, const std::uint8_t* data )
+{
+    switch ( wav.bits ) {
+        case 8:
+            return ( data[0] - 128 ) * ( 1.0f / 128.0f );
+        case 16:
+            return std::int16_t ( le16 ( data ) ) * ( 1.0f / 32768.0f );
+        case 24:
+            return std::int32_t ( data[0] << 8 | data[1] << 16 | std::uint32_t ( data[2] ) << 24 ) * ( 1.0f / 2147483648.0f );
+        default:
+            if ( wav.format == WAVE_FORMAT_IEEE_FLOAT ) {
+                float value;
+                auto bits = le32 ( data );
+                std::memcpy ( &value, &bits, sizeof value );
+                return value;
+            }
+            return std::int32_t ( le32 ( data ) ) * ( 1.0f / 2147483648.0f );
+    }
+}
+
+bool WavInterface::valid ( std::istream* stream ) const
+{
+    stream->seekg(0);
+    char header[12]{};
+    stream->read ( header, sizeof header );
+    return !std::memcmp ( header, "RIFF", 4 ) && !std::memcmp ( header + 8, "WAVE", 4 );
+}
+
+void WavInterface::init ( MAudioStream* audioStream ) const
+{
+    auto data = source ( audioStream );
+    if ( !data ) {
+        // only a stream to read from, keep a copy of it
+        stream ( audioStream ) ->seekg(0);
+        auto copy = std::make_shared<std::string> ( std::istreambuf_iterator<char> { *stream ( audioStream ) }, std::istreambuf_iterator<char>{} );
+        data = MByteSource{copy, reinterpret_cast<const std::uint8_t*> ( copy->data() ), copy->size()};
+    }
+
+    auto wav = new WavFile{};
+    int freq = 0;
+    bool format = false;
+    for ( std::size_t offset = 12; offset + 8 <= data.size(); ) {
+        auto id = data.data() + offset;
+        std::size_t size = std::min<std::size_t> ( le32 ( id + 4 ), data.size() - offset - 8 );
+        auto body = id + 8;
+        if ( !std::memcmp ( id, "fmt ", 4 ) && size >= 16 ) {
+            wav->format = le16 ( body );
+            wav->channels = le16 ( body + 2 );
+            freq = le32 ( body + 4 );
+            wav->frame = le16 ( body + 12 );
+            wav->bits = le16 ( body + 14 );
+            if ( wav->format == WAVE_FORMAT_EXTENSIBLE && size >= 26 )
+                wav->format = le16 ( body + 24 );
+            format = true;
+        }
+        else if ( !std::memcmp ( id, "data", 4 ) )
+            wav->samples = data.slice ( offset + 8, size );
+        else if ( !std::memcmp ( id, "LIST", 4 ) && size >= 4 && !std::memcmp ( body, "INFO", 4 ) ) {
+            for ( std::size_t i = 4; i + 8 <= size; ) {
+                auto item = body + i;
+                std::size_t length = std::min<std::size_t> ( le32 ( item + 4 ), size - i - 8 );
+                auto text = reinterpret_cast<const char*> ( item + 8 );
+                wav->info.emplace_back ( std::string { reinterpret_cast<const char*> ( item ), 4 }, std::string { text, std::find ( text, text + length, '\0' ) } );
+                i += 8 + length + ( length & 1 );
+            }
+        }
+        // chunks are padded to an even size
+        offset += 8 + size + ( size & 1 );
+    }
+
+    bool supported = ( wav->format == WAVE_FORMAT_PCM && ( wav->bits == 8 || wav->bits == 16 || wav->bits == 24 || wav->bits == 32 ) ) ||
+                     ( wav->format == WAVE_FORMAT_IEEE_FLOAT && wav->bits == 32 );
+    if ( !format || !supported || !wav->channels || !freq || wav->frame != std::size_t ( wav->channels * wav->bits / 8 ) ) {
+        if ( format )
+            mDebug(ERROR) << "Unsupported WAV format " << wav->format << " with " << wav->bits << " bits";
+        delete wav;
+        return;
+    }
+    wav->frames = wav->samples.size() / wav->frame;
+    setEOF ( audioStream, false );
+    setFreq ( audioStream, freq );
+    // anything past the first two channels is dropped
+    setStereo ( audioStream, wav->channels > 1 );
+    setUserData ( audioStream, wav );
+    setValid ( audioStream );
+}
+
+void WavInterface::fini ( MAudioStream* audioStream ) const
+{
+    delete &userdata<WavFile> ( audioStream );
+}
+
+const char* WavInterface::map ( MAudioStream* audioStream, std::size_t& size ) const
+{
+    auto& wav = userdata<WavFile> ( audioStream );
+    auto frames = std::min ( size / wav.frame, wav.frames - wav.position );
+    if ( !native ( wav ) || !frames )
+        return nullptr;
+    auto data = wav.samples.data() + wav.position * wav.frame;
+    wav.position += frames;
+    size = frames * wav.frame;
+    if ( wav.position == wav.frames )
+        setEOF ( audioStream );
+    return reinterpret_cast<const char*> ( data );
+}
+
+std::size_t WavInterface::read ( MAudioStream* audioStream, char* buffer, std::size_t size ) const
+{
+    auto& wav = userdata<WavFile> ( audioStream );
+    std::size_t channels = audioStream->stereo() ? 2 : 1;
+    auto frames = std::min ( size / ( channels * sizeof(std::int16_t) ), wav.frames - wav.position );
+    auto data = wav.samples.data() + wav.position * wav.frame;
+    if ( native ( wav ) )
+        std::memcpy ( buffer, data, frames * wav.frame );
+    else {
+        auto pcm = reinterpret_cast<std::int16_t*> ( buffer );
+        for ( std::size_t i = 0; i < frames; i++ )
+            for ( std::size_t c = 0; c < channels; c++ ) {
+                auto value = sample ( wav, data + i * wav.frame + c * wav.bits / 8 );
+                pcm[i * channels + c] = std::lrint ( std::clamp ( value, -1.0f, 1.0f ) * 32767.0f );
+            }
+    }
+    wav.position += frames;
+    if ( wav.position == wav.frames )
+        setEOF ( audioStream );
+    return frames * channels * sizeof(std::int16_t);
+}
+
+std::size_t WavInterface::readFloat ( MAudioStream* audioStream, float* buffer, std::size_t count ) const
+{
+    auto& wav = userdata<WavFile> ( audioStream );
+    std::size_t channels = audioStream->stereo() ? 2 : 1;
+    auto frames = std::min ( count / channels, wav.frames - wav.position );
+    auto data = wav.samples.data() + wav.position * wav.frame;
+    for ( std::size_t i = 0; i < frames; i++ )
+        for ( std::size_t c = 0; c < channels; c++ )
+            buffer[i * channels + c] = sample ( wav, data + i * wav.frame + c * wav.bits / 8 );
+    wav.position += frames;
+    if ( wav.position == wav.frames )
+        setEOF ( audioStream );
+    return frames * channels;
+}
+
+void WavInterface::seek ( MAudioStream* audioStream, double seconds ) const
+{
+    auto& wav = userdata<WavFile> ( audioStream );
+    wav.position = std::min<std::size_t> ( std::max ( std::llround ( seconds * audioStream->freq() ), 0ll ), wav.frames );
+}
+
+double WavInterface::tell ( MAudioStream* audioStream ) const
+{
+    return double ( userdata<WavFile> ( audioStream ).position ) / audioStream->freq();
+}
+
+double WavInterface::length ( MAudioStream* audioStream ) const
+{
+    return double ( userdata<WavFile> ( audioStream ).frames ) / audioStream->freq();
+}
+
+std::int64_t WavInterface::frames ( MAudioStream* audioStream ) const
+{
+    return userdata<WavFile> ( audioStream ).frames;
+}
+
+std::list<std::string> WavInterface::getTag ( MAudioStream* audioStream, MAudioTag tag ) const
+{
+    const char* id = nullptr;
+    switch ( tag ) {
+        case M_AUDIO_TAG_TITLE:
+            id = "INAM";
+            break;
+        case M_AUDIO_TAG_ARTIST:
+            id = "IART";
+            break;
+        case M_AUDIO_TAG_COMPOSER:
+            id = "IMUS";
+            break;
+        case M_AUDIO_TAG_ALBUM:
+            id = "IPRD";
+            break;
+        case M_AUDIO_TAG_DATE:
+            id = "ICRD";
+            break;
+        case M_AUDIO_TAG_COMMENT:
+            id = "ICMT";
+            break;
+        case M_AUDIO_TAG_GENRE:
+            id = "IGNR";
+            break;
+        case M_AUDIO_TAG_TRACK_NUMBER:
+            id = "ITRK";
+            break;
+        default:
+            break;
+    }
+    if ( !id )
+        return {};
+
+    std::list<std::string> ret;
+    for ( auto& info: userdata<WavFile> ( audioStream ).info )
+        if ( info.first == id )
+            ret.push_back ( info.second );
+    return ret;
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of MLib
+ * Copyright (C) 2026  Matija Skala <mskala@gmx.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <mresourcepack_p.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+struct File {
+    string name;
+    filesystem::path path;
+    uint64_t size;
+};
+
+int main ( int argc, char** argv ) {
+    if ( argc != 3 ) {
+        cerr << "Usage: " << argv[0] << " DIRECTORY ARCHIVE" << endl;
+        return 1;
+    }
+    filesystem::path root = argv[1];
+    vector<File> files;
+    for ( auto&& f: filesystem::recursive_directory_iterator{root} ) {
+        if ( !f.is_regular_file() || f.path().filename().string().front() == '.' )
+            continue;
+        files.push_back ( { f.path().lexically_relative ( root ).generic_string(), f.path(), f.file_size() } );
+    }
+    sort ( files.begin(), files.end(), [] ( const File& a, const File& b ) { return a.name < b.name; } );
+
+    MResourcePackHeader header{};
+    memcpy ( header.magic, M_RESOURCE_PACK_MAGIC, sizeof header.magic );
+    leStore ( header.version, M_RESOURCE_PACK_VERSION );
+    leStore ( header.count, files.size() );
+
+    vector<MResourcePackEntry> entries ( files.size() );
+    uint64_t offset = sizeof header + entries.size() * sizeof ( MResourcePackEntry );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+        leStore ( entries[i].name, offset );
+        leStore ( entries[i].nameSize, files[i].name.size() );
+        offset += files[i].name.size();
+    }
+    for ( size_t i = 0; i < files.size(); i++ ) {
+        offset = ( offset + M_RESOURCE_PACK_ALIGNMENT - 1 ) & ~( M_RESOURCE_PACK_ALIGNMENT - 1 );
+        leStore ( entries[i].offset, offset );
+        leStore ( entries[i].size, files[i].size );
+        offset += files[i].size;
+    }
+
+    ofstream out{argv[2], ios::binary | ios::trunc};
+    out.write ( reinterpret_cast<const char*> ( &header ), sizeof header );
+    out.write ( reinterpret_cast<const char*> ( entries.data() ), entries.size() * sizeof ( MResourcePackEntry ) );
+    for ( auto&& f: files )
+        out.write ( f.name.data(), f.name.size() );
+    vector<char> buffer ( 0x10000 );
+    for ( size_t i = 0; i < files.size(); i++ ) {
+        out.seekp ( leLoad ( entries[i].offset ) );
+        ifstream in{files[i].path, ios::binary};
+        uint64_t left = files[i].size;
+        while ( left && in.read ( buffer.data(), min<uint64_t> ( left, buffer.size() ) ) ) {
+            out.write ( buffer.data(), in.gcount() );
+            left -= in.gcount();
+        }
+        if ( left ) {
+            cerr << files[i].path.string() << ": Read error" << endl;
+            return 1;
+        }
+    }
+    out.seekp ( 0, ios::end );
+    if ( static_cast<uint64_t> ( out.tellp() ) < offset ) {
+        out.seekp ( offset - 1 );
+        out.put ( 0 );
+    }
+    if ( !out ) {
+        cerr << argv[2] << ": Write error" << endl;
+        return 1;
+    }
+    return 0;
+}